@@ -0,0 +1,32 @@
+/*
+// The cache line of the assignments, the cache of assignment_3 and the
+// names of cache sizes, for the simulators that sweep cache configurations.
+*/
+
+#ifndef PSA_CACHE_SIZE_H
+#define PSA_CACHE_SIZE_H
+
+#include <cstddef>
+#include <string>
+
+// The cache line of the assignments, 32 bytes.
+static const size_t LINE_SIZE = 32;
+
+// The cache of assignment_3 and the fast engine: 32KB, 8-way set associative.
+// A line with tag t in set s holds the address (t * NR_SETS + s) * LINE_SIZE.
+static const size_t CACHE_SIZE = 32 << 10;
+static const size_t CACHE_WAYS = 8;
+static const size_t NR_SETS = CACHE_SIZE / (CACHE_WAYS * LINE_SIZE);
+
+// `bytes` in the largest unit it is a whole number of: 32KB, 1MB, 96B.
+inline std::string size_name(size_t bytes) {
+    if (bytes >= (1 << 20) && bytes % (1 << 20) == 0) {
+        return std::to_string(bytes >> 20) + "MB";
+    }
+    if (bytes >= (1 << 10) && bytes % (1 << 10) == 0) {
+        return std::to_string(bytes >> 10) + "KB";
+    }
+    return std::to_string(bytes) + "B";
+}
+
+#endif // PSA_CACHE_SIZE_H
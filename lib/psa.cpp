@@ -6,22 +6,26 @@
 // can be used to read such files and drive a simulator. Traces can be read
 // independently for each processor. After a trace has finished, NOP operations
 // will be read.
-// Other functions included in here are to keep track of and to print statistics
-//
-// -- STUDENTS SHOULD NOT NEED TO MODIFY THIS FILE --
+// Other functions included in here are to keep track of and to print statistics.
+// The counters live in a SimulationContext; the free functions use the
+// default context, so simulators can also run several contexts at once.
 //
 // Author(s): Michiel W. van Tol, Mike Lankamp, Simon Polstra
 
 // 64 bit address version
 */
 
-#include "psa.h"
+// Only the part without SystemC, every target links this file.
+#include "simulation.h"
 #include <arpa/inet.h>
+#include <iostream>
 #include <stdexcept>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 
 #if defined(OS_MACOSX)
@@ -46,35 +50,42 @@ uint64_t ntohll(uint64_t net) {
 }
 #endif
 
-// Internal structure to keep track of statistics per Manager
-struct stats {
-    int writehit;
-    int writemiss;
-    int readhit;
-    int readmiss;
-    int memory_access;
-    vector<double> buswaitcycle;
-};
-
-// Constant to put a 64 bit wire in high impedance mode.
+// Constant to put a 64 bit wire in high impedance mode, declared in psa.h.
 const char *float_64_bit_wire = "ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ";
 
-static stats *stats_percpu = NULL;
-TraceFile *tracefile_ptr = NULL;
-uint32_t num_cpus = 0;
+SimulationContext &default_context() {
+    static SimulationContext context;
+    return context;
+}
+
+uint32_t &num_cpus = default_context().num_cpus;
+TraceFile *&tracefile_ptr = default_context().tracefile;
+
+SimulationContext::SimulationContext(uint32_t num_cpus)
+: num_cpus(num_cpus), tracefile(NULL), sample_num_sets(0), sample_validate(false) {}
+
+SimulationContext::~SimulationContext() {
+    delete this->tracefile;
+}
+
+void SimulationContext::open_trace(const char *filename) {
+    // Open the tracefile and create TraceFile object
+    TraceFile *trace = new TraceFile(filename);
+    delete this->tracefile;
+    this->tracefile = trace;
+
+    // Get the number of Manager's from the tracefile
+    this->num_cpus = trace->get_proc_count();
+}
 
 // Initializes the tracefile from the 1st argv argument then takes it out of
 // argc/argv for argument parsing elsewhere
-void init_tracefile(int *argc, char **argv[]) {
+void init_tracefile(SimulationContext &context, int *argc, char **argv[]) {
     // Check if we got at least one argument, otherwise throw an error
     if (*argc < 2) {
         throw runtime_error(string("Error, usage: ") + (*argv)[0] + string(" <tracefile>"));
     } else {
-        // Open the tracefile and create TraceFile object
-        tracefile_ptr = new TraceFile((*argv)[1]);
-
-        // Get the number of Manager's from the tracefile
-        num_cpus = tracefile_ptr->get_proc_count();
+        context.open_trace((*argv)[1]);
 
         // Reset arguments to the next set
         *argv = &((*argv)[2]);
@@ -82,96 +93,255 @@ void init_tracefile(int *argc, char **argv[]) {
     }
 }
 
-// Allocates and sets up stats datastructure
-void stats_init() {
-    stats_percpu = (stats *)malloc(sizeof(stats) * num_cpus);
-    if (stats_percpu == NULL) {
-        throw runtime_error(
-        string("Error, unable to allocate statistics memory"));
-    }
-
-    for (unsigned int i = 0; i < num_cpus; i++) {
-        stats_percpu[i].writehit = 0;
-        stats_percpu[i].writemiss = 0;
-        stats_percpu[i].readhit = 0;
-        stats_percpu[i].readmiss = 0;
-        stats_percpu[i].memory_access = 0;
+void init_tracefile(int *argc, char **argv[]) {
+    init_tracefile(default_context(), argc, argv);
+}
 
-        stats_percpu[i].buswaitcycle = vector<double>();
-    }
+// Allocates and sets up stats datastructure
+void SimulationContext::stats_init() {
+    this->counters = vector<stats_snapshot>(this->num_cpus, stats_snapshot{0, 0, 0, 0, 0, 0, 0});
 }
 
-void stats_cleanup() {
-    free(stats_percpu);
+void SimulationContext::stats_cleanup() {
+    this->counters.clear();
 }
 
-void stats_print() {
-    if (stats_percpu == NULL) {
+void SimulationContext::stats_print(ostream &out) const {
+    if (this->counters.empty()) {
         throw runtime_error(
         string("Error, unable to open statistics. Did you run stats_init()?"));
     }
-    printf("Manager\tReads\tRHit\tRMiss\tWrites\tWHit\tWMiss\tHitrate\t\tMAccessTime\tWaitBus\n");
+    out << "Manager\tReads\tRHit\tRMiss\tWrites\tWHit\tWMiss\tHitrate\t\tMAccessTime\tWaitBus\n";
 
     double total_avg_wait = 0;
-    for (unsigned int i = 0; i < num_cpus; i++) {
-        int writes = stats_percpu[i].writehit + stats_percpu[i].writemiss;
-        int reads = stats_percpu[i].readhit + stats_percpu[i].readmiss;
+    for (unsigned int i = 0; i < this->num_cpus; i++) {
+        const stats_snapshot &s = this->counters[i];
+        int writes = s.writehit + s.writemiss;
+        int reads = s.readhit + s.readmiss;
 
         // Ratio of hits to the number of total accesses
-        double hitrate = (stats_percpu[i].writehit + stats_percpu[i].readhit) /
-                         (double)(writes + reads);
-
-        double total_cycles = 0;
-        for (auto cycles : stats_percpu[i].buswaitcycle) {
-            total_cycles += cycles;
-        }
+        double hitrate = (s.writehit + s.readhit) / (double)(writes + reads);
 
-        double avg_wait = total_cycles / (double) stats_percpu[i].buswaitcycle.size();
+        double avg_wait = s.buswaitcycle / (double) s.buswaits;
         // To make it a percentage
         total_avg_wait += avg_wait;
 
         hitrate = hitrate * 100;
 
-        printf("%d\t%d\t%d\t%d\t%d\t%d\t%d\t%f\t%d\t\t%f\n", i, reads,
-               stats_percpu[i].readhit, stats_percpu[i].readmiss, writes,
-               stats_percpu[i].writehit, stats_percpu[i].writemiss, hitrate, stats_percpu[i].memory_access,
-               avg_wait);
+        char line[256];
+        snprintf(line, sizeof(line), "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%f\t%d\t\t%f\n", i, reads, s.readhit,
+                 s.readmiss, writes, s.writehit, s.writemiss, hitrate, s.memory_access, avg_wait);
+        out << line;
     }
+    out.flush();
 }
 
-void stats_memory_access(uint32_t cpuid, int cycles) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].memory_access += cycles;
+stats_snapshot SimulationContext::stats_save(uint32_t cpuid) const {
+    if (cpuid >= this->counters.size()) {
+        throw runtime_error(
+        string("Error, unable to open statistics. Did you run stats_init()?"));
     }
+    return this->counters[cpuid];
 }
-void stats_waitbus(uint32_t cpuid, double cycles) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].buswaitcycle.push_back(cycles);
+
+void SimulationContext::stats_restore(uint32_t cpuid, const stats_snapshot &snapshot) {
+    if (cpuid >= this->counters.size()) {
+        throw runtime_error(
+        string("Error, unable to open statistics. Did you run stats_init()?"));
     }
+    this->counters[cpuid] = snapshot;
+}
+
+void stats_init() {
+    default_context().stats_init();
+}
+
+void stats_cleanup() {
+    default_context().stats_cleanup();
+}
+
+void stats_print() {
+    default_context().stats_print(cout);
+}
+
+void stats_memory_access(uint32_t cpuid, int cycles) {
+    default_context().stats_memory_access(cpuid, cycles);
+}
+
+void stats_waitbus(uint32_t cpuid, double cycles) {
+    default_context().stats_waitbus(cpuid, cycles);
+}
+
+stats_snapshot stats_save(uint32_t cpuid) {
+    return default_context().stats_save(cpuid);
+}
+
+void stats_restore(uint32_t cpuid, const stats_snapshot &snapshot) {
+    default_context().stats_restore(cpuid, snapshot);
 }
 
 void stats_writehit(uint32_t cpuid) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].writehit++;
-    }
+    default_context().stats_writehit(cpuid);
 }
 
 void stats_writemiss(uint32_t cpuid) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].writemiss++;
-    }
+    default_context().stats_writemiss(cpuid);
 }
 
 void stats_readhit(uint32_t cpuid) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].readhit++;
-    }
+    default_context().stats_readhit(cpuid);
 }
 
 void stats_readmiss(uint32_t cpuid) {
-    if (cpuid < num_cpus && stats_percpu != NULL) {
-        stats_percpu[cpuid].readmiss++;
+    default_context().stats_readmiss(cpuid);
+}
+
+// A 64 bit mix of the set index, sets in a row land far apart.
+static uint64_t sample_hash(uint64_t set) {
+    set ^= set >> 33;
+    set *= 0xff51afd7ed558ccdULL;
+    set ^= set >> 33;
+    set *= 0xc4ceb9fe1a85ec53ULL;
+    set ^= set >> 33;
+    return set;
+}
+
+void SimulationContext::sample_init(size_t num_sets, uint32_t ratio, bool validate) {
+    if (num_sets == 0 || ratio == 0) {
+        throw runtime_error(string("Error, set sampling needs sets and a positive ratio"));
+    }
+    // The num_sets / ratio sets with the lowest hash, at least one.
+    vector<size_t> order(num_sets);
+    for (size_t i = 0; i < num_sets; i++) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [](size_t a, size_t b) { return sample_hash(a) < sample_hash(b); });
+    size_t chosen = max<size_t>(1, num_sets / ratio);
+
+    this->sample_num_sets = num_sets;
+    this->sample_validate = validate;
+    this->sample_chosen = vector<bool>(num_sets, false);
+    for (size_t i = 0; i < chosen; i++) {
+        this->sample_chosen[order[i]] = true;
+    }
+    this->sample_skipped = vector<bool>(num_sets, false);
+    for (size_t i = 0; i < num_sets && !validate; i++) {
+        this->sample_skipped[i] = !this->sample_chosen[i];
+    }
+    this->sample_sets = vector<sample_set>(this->num_cpus * num_sets, sample_set{0, 0});
+}
+
+void SimulationContext::sample_access(uint32_t cpuid, size_t set, bool hit) {
+    if (cpuid < this->num_cpus && set < this->sample_num_sets && !this->sample_sets.empty()) {
+        sample_set &s = this->sample_sets[cpuid * this->sample_num_sets + set];
+        s.accesses++;
+        s.misses += hit ? 0 : 1;
+    }
+}
+
+// The miss rate of the sampled sets of a cache, or of all caches with
+// cpuid == num_cpus, as a ratio estimate. `half` is the half width of its
+// 95% confidence interval, with the finite population correction, NAN for
+// less than two sampled sets.
+double SimulationContext::sample_estimate(uint32_t cpuid, double *half) const {
+    uint32_t first = cpuid == this->num_cpus ? 0 : cpuid;
+    uint32_t last = cpuid == this->num_cpus ? this->num_cpus : cpuid + 1;
+
+    // A sampled set of all caches is one sample.
+    vector<sample_set> samples;
+    for (size_t set = 0; set < this->sample_num_sets; set++) {
+        if (!this->sample_chosen[set]) continue;
+        sample_set sum{0, 0};
+        for (uint32_t i = first; i < last; i++) {
+            sum.accesses += this->sample_sets[i * this->sample_num_sets + set].accesses;
+            sum.misses += this->sample_sets[i * this->sample_num_sets + set].misses;
+        }
+        samples.push_back(sum);
+    }
+
+    double accesses = 0, misses = 0;
+    for (const auto &s : samples) {
+        accesses += (double) s.accesses;
+        misses += (double) s.misses;
+    }
+    double rate = accesses > 0 ? misses / accesses : 0;
+
+    double n = (double) samples.size();
+    if (samples.size() < 2 || accesses == 0) {
+        *half = NAN;
+        return rate;
+    }
+    double residuals = 0;
+    for (const auto &s : samples) {
+        double residual = (double) s.misses - rate * (double) s.accesses;
+        residuals += residual * residual;
+    }
+    double mean = accesses / n;
+    double variance = (1 - n / (double) this->sample_num_sets) * residuals / (n - 1) / (n * mean * mean);
+    *half = 1.96 * sqrt(variance);
+    return rate;
+}
+
+// The miss rate of every set, with validate.
+double SimulationContext::sample_full(uint32_t cpuid) const {
+    uint32_t first = cpuid == this->num_cpus ? 0 : cpuid;
+    uint32_t last = cpuid == this->num_cpus ? this->num_cpus : cpuid + 1;
+    double accesses = 0, misses = 0;
+    for (size_t i = first * this->sample_num_sets; i < last * this->sample_num_sets; i++) {
+        accesses += (double) this->sample_sets[i].accesses;
+        misses += (double) this->sample_sets[i].misses;
+    }
+    return accesses > 0 ? misses / accesses : 0;
+}
+
+void SimulationContext::sample_print(ostream &out) const {
+    if (this->sample_sets.empty()) {
+        throw runtime_error(
+        string("Error, unable to open the set sampling. Did you run sample_init()?"));
+    }
+    size_t chosen = 0;
+    for (bool c : this->sample_chosen) {
+        chosen += c ? 1 : 0;
     }
+    char line[256];
+    snprintf(line, sizeof(line), "Set sampling: %lu of %lu sets\n", (unsigned long) chosen,
+             (unsigned long) this->sample_num_sets);
+    out << line;
+    out << (this->sample_validate ? "Manager\tMissrate\t95% CI\t\t\tFull\t\tError\n" : "Manager\tMissrate\t95% CI\n");
+
+    for (uint32_t i = 0; i <= this->num_cpus; i++) {
+        double half;
+        double rate = 100 * this->sample_estimate(i, &half);
+        half *= 100;
+        out << (i == this->num_cpus ? string("All") : to_string(i));
+        snprintf(line, sizeof(line), "\t%f\t%f - %f", rate, rate - half, rate + half);
+        out << line;
+        if (this->sample_validate) {
+            double full = 100 * this->sample_full(i);
+            // The interval holds the full miss rate in about 95% of the samples.
+            snprintf(line, sizeof(line), "\t%f\t%+f%s", full, rate - full,
+                     fabs(rate - full) <= half ? "" : " outside the CI");
+            out << line;
+        }
+        out << "\n";
+    }
+    out.flush();
+}
+
+void sample_init(size_t num_sets, uint32_t ratio, bool validate) {
+    default_context().sample_init(num_sets, ratio, validate);
+}
+
+bool sample_skips(size_t set) {
+    return default_context().sample_skips(set);
+}
+
+void sample_access(uint32_t cpuid, size_t set, bool hit) {
+    default_context().sample_access(cpuid, set, hit);
+}
+
+void sample_print() {
+    default_context().sample_print(cout);
 }
 
 TraceFile::TraceFile(const char *filename)
@@ -201,6 +371,7 @@ TraceFile::TraceFile(const char *filename)
     // Set the start positions of the processor traces
     m_positions.resize(procs_count);
     streampos start = m_input.tellg();
+    m_start = start;
 
     // And in the meanwhile store the end position of the file
     m_input.seekg(0, ios::end);
@@ -226,6 +397,38 @@ uint32_t TraceFile::get_proc_count() const {
     return m_positions.size();
 }
 
+uint64_t TraceFile::position(uint32_t pid) const {
+    if (m_positions[pid] == (streampos)0) {
+        return 0;
+    }
+    streamoff offset = m_positions[pid] - m_start - (streamoff)(pid * entry_size);
+    return (uint64_t)offset / (get_proc_count() * entry_size);
+}
+
+bool TraceFile::ended(uint32_t pid) const {
+    return m_positions[pid] == (streampos)0;
+}
+
+void TraceFile::seek(uint32_t pid, uint64_t position, bool finished) {
+    if (pid >= get_proc_count()) {
+        throw runtime_error("Invalid processor in seek");
+    }
+    if (finished && !ended(pid)) {
+        m_num_finished++;
+    } else if (!finished && ended(pid)) {
+        m_num_finished--;
+    }
+    if (finished) {
+        m_positions[pid] = 0;
+        return;
+    }
+    streampos target = m_start + (streamoff)((position * get_proc_count() + pid) * entry_size);
+    if (target > m_endstream) {
+        throw runtime_error("Seek past the end of the tracefile");
+    }
+    m_positions[pid] = target;
+}
+
 bool TraceFile::next(uint32_t pid, Entry &e) {
     uint32_t cpucount = get_proc_count();
 
@@ -0,0 +1,254 @@
+/*
+// Header file for the Parallel System Architectures Lab Session.
+// The part of psa.h without SystemC: the TraceFile class, the statistic
+// counters and the SimulationContext that holds them. Simulators with a
+// main of their own include this header and do not link SystemC.
+//
+// Author(s): Michiel W. van Tol, Mike Lankamp, Simon Polstra
+*/
+
+#ifndef PSA_SIMULATION_H
+#define PSA_SIMULATION_H
+
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+// Define fixed-size types
+// Support non-compliant C99 compilers
+#if defined(_MSC_VER)
+typedef __int8 int8_t;
+typedef __int16 int16_t;
+typedef __int32 int32_t;
+typedef __int64 int64_t;
+typedef unsigned __int8 uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+// We just hope that this compiler properly supports the C++ standard
+#define __STDC_LIMIT_MACROS
+#include <stdint.h>
+#endif
+
+/*
+ * Initializes the Tracefile and sets the number of cpu's. It expects the
+ * first argument from argv to be the Tracefile name, and modifies argv/argc
+ * to remove this argument so that the user can add their own options and
+ * argument parser after this function
+ */
+void init_tracefile(int *argc, char **argv[]);
+
+// The same for the trace of `context`, see SimulationContext.
+class SimulationContext;
+void init_tracefile(SimulationContext &context, int *argc, char **argv[]);
+
+/*
+ * Initializes the statistic counters, needs to be run after init_tracefile
+ * as it uses num_cpus to generate its datastructures.
+ */
+void stats_init();
+
+// Removes and cleanes up the internal statistic counters
+void stats_cleanup();
+
+// Pretty-prints the contents of the statistic counters
+void stats_print();
+
+// Updates the internal statistic counters for given Manager
+void stats_writehit(uint32_t cpuid);
+void stats_writemiss(uint32_t cpuid);
+void stats_readhit(uint32_t cpuid);
+void stats_readmiss(uint32_t cpuid);
+void stats_memory_access(uint32_t, int);
+void stats_waitbus(uint32_t cpuid, double cycles);
+
+// The statistic counters of a Manager, for checkpoints.
+struct stats_snapshot {
+    int writehit;
+    int writemiss;
+    int readhit;
+    int readmiss;
+    int memory_access;
+    double buswaitcycle; // the sum over the waits on the bus,
+    uint64_t buswaits;   // and how many there were.
+};
+stats_snapshot stats_save(uint32_t cpuid);
+void stats_restore(uint32_t cpuid, const stats_snapshot &snapshot);
+
+/*
+ * Set sampling: only one in `ratio` sets of a cache is simulated, picked by
+ * a hash of the set index, the same sets in every cache. Caches skip the
+ * accesses to the other sets before any LRU work and count the hits and
+ * misses of every set they simulate. sample_print estimates the miss rate
+ * from the sampled sets, with a 95% confidence interval over the sets.
+ * With `validate` every set is simulated and the estimate is compared with
+ * the miss rate of all sets. Runs after stats_init.
+ */
+void sample_init(size_t num_sets, uint32_t ratio, bool validate);
+
+// Whether the accesses to a set are skipped, never without sample_init.
+bool sample_skips(size_t set);
+
+void sample_access(uint32_t cpuid, size_t set, bool hit);
+
+void sample_print();
+
+class TraceFile {
+    public:
+    // Data type of a memory request's operation type.
+    enum EntryType {
+        ENTRY_TYPE_NOP = 0x0,
+        ENTRY_TYPE_READ = 0x1,
+        ENTRY_TYPE_WRITE = 0x2,
+        ENTRY_TYPE_END = 0x3 // End is only used internally
+    };
+
+    // Data type of a memory request entry for a processor
+    struct Entry {
+        EntryType type;
+        uint64_t addr;
+    };
+
+    // An entry as it is stored in the file, for readers that load the
+    // file themselves: 8 bytes big endian, the two most significant bits
+    // are the type.
+    static Entry decode(const unsigned char *bytes) {
+        uint64_t data = 0;
+        for (size_t b = 0; b < 8; b++) {
+            data = (data << 8) | bytes[b];
+        }
+        return Entry{(EntryType) (data >> 62), data & ~(0x3ULL << 62)};
+    }
+
+    // Constructor / Destructor
+    TraceFile(const char *filename);
+    ~TraceFile();
+
+    // Closes the file
+    void close();
+
+    /*
+     * Reads the next entry from the file for the processor specified in pid.
+     * Parameter e is a reference to the Entry structure which will receive
+     * the data.
+     */
+    bool next(uint32_t pid, Entry &e);
+
+    // Determines if the end-of-file has been reached
+    bool eof() const;
+
+    // Returns the number of processors this file contains traces for
+    uint32_t get_proc_count() const;
+
+    // The number of entries read for processor pid, and whether its trace
+    // ended, for checkpoints.
+    uint64_t position(uint32_t pid) const;
+    bool ended(uint32_t pid) const;
+
+    // Continues the trace of processor pid after `position` entries.
+    void seek(uint32_t pid, uint64_t position, bool finished);
+
+    private:
+    const uint32_t entry_size = 8; // Trace element is 8 bytes.
+    struct EntryInfo;
+
+    std::ifstream m_input;
+    std::vector<std::streampos> m_positions;
+    std::streampos m_start;
+    uint32_t m_num_finished;
+    std::streampos m_endstream;
+
+    // Private copy constructor because no copies are allowed.
+    TraceFile(const TraceFile &trf);
+};
+
+/*
+ * The state of one simulation: its trace, the number of Managers, the
+ * statistic counters and the set sampling. The modules of a simulation
+ * hold a reference to its context and never use the globals, so
+ * independent simulations can run on separate host threads of one
+ * process. The functions above and the globals below are those of
+ * default_context(), the simulation of the assignments.
+ */
+class SimulationContext {
+    public:
+    // A context for a trace of `num_cpus` Managers read elsewhere, or
+    // for open_trace.
+    explicit SimulationContext(uint32_t num_cpus = 0);
+    ~SimulationContext();
+
+    // Opens the trace and sets num_cpus from it.
+    void open_trace(const char *filename);
+
+    uint32_t num_cpus;
+    TraceFile *tracefile; // NULL before open_trace.
+
+    void stats_init();
+    void stats_cleanup();
+    void stats_print(std::ostream &out) const;
+
+    void stats_writehit(uint32_t cpuid) {
+        if (cpuid < this->counters.size()) this->counters[cpuid].writehit++;
+    }
+    void stats_writemiss(uint32_t cpuid) {
+        if (cpuid < this->counters.size()) this->counters[cpuid].writemiss++;
+    }
+    void stats_readhit(uint32_t cpuid) {
+        if (cpuid < this->counters.size()) this->counters[cpuid].readhit++;
+    }
+    void stats_readmiss(uint32_t cpuid) {
+        if (cpuid < this->counters.size()) this->counters[cpuid].readmiss++;
+    }
+    void stats_memory_access(uint32_t cpuid, int cycles) {
+        if (cpuid < this->counters.size()) this->counters[cpuid].memory_access += cycles;
+    }
+    void stats_waitbus(uint32_t cpuid, double cycles) {
+        if (cpuid < this->counters.size()) {
+            this->counters[cpuid].buswaitcycle += cycles;
+            this->counters[cpuid].buswaits++;
+        }
+    }
+    stats_snapshot stats_save(uint32_t cpuid) const;
+    void stats_restore(uint32_t cpuid, const stats_snapshot &snapshot);
+
+    void sample_init(size_t num_sets, uint32_t ratio, bool validate);
+    bool sample_skips(size_t set) const {
+        return set < this->sample_skipped.size() && this->sample_skipped[set];
+    }
+    void sample_access(uint32_t cpuid, size_t set, bool hit);
+    void sample_print(std::ostream &out) const;
+
+    private:
+    // Hits and misses of one set of one cache.
+    struct sample_set {
+        uint64_t accesses;
+        uint64_t misses;
+    };
+
+    std::vector<stats_snapshot> counters; // empty before stats_init.
+
+    size_t sample_num_sets;
+    bool sample_validate;
+    std::vector<bool> sample_chosen; // the sampled sets.
+    std::vector<bool> sample_skipped;
+    std::vector<sample_set> sample_sets; // sample_num_sets per cpu.
+
+    double sample_estimate(uint32_t cpuid, double *half) const;
+    double sample_full(uint32_t cpuid) const;
+
+    // No copies, the modules hold references.
+    SimulationContext(const SimulationContext &);
+    SimulationContext &operator=(const SimulationContext &);
+};
+
+// The context of the free functions and the globals.
+SimulationContext &default_context();
+
+// Global value giving the number of Manager's in the simulation
+extern uint32_t &num_cpus;
+
+// Global pointer to the TraceFile class of the opened Tracefile
+extern TraceFile *&tracefile_ptr;
+
+#endif
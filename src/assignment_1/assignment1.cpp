@@ -10,6 +10,8 @@
  *
  */
 
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include "psa.h"
 #include "lru.h"
@@ -36,6 +38,12 @@ public:
     }
 
     uint8_t read(uint64_t addr) const {
+        // Set sampling does not simulate the set, the access takes the
+        // cycle of reading the set out.
+        if (sample_skips((addr >> 5) % NR_SETS)) {
+            sc_core::wait(1);
+            return 0;
+        }
         // Return true if there is a cache.
         // 32kB / (32 * 8) Byte = 128 sets.
         // address is 64 bits.
@@ -63,6 +71,11 @@ public:
     }
 
     void store(uint64_t addr, uint32_t data) const {
+        // The Manager waits a cycle after the data, before it waits for us.
+        if (sample_skips((addr >> 5) % NR_SETS)) {
+            sc_core::wait(1);
+            return;
+        }
         // default 4 bytes data.
         cout << endl << sc_time_stamp()
              << " [WRITE]: Manager sends writes to: 0x"
@@ -221,14 +234,42 @@ private:
     }
 };
 
+static const char *usage =
+        "options (after the tracefile):\n"
+        "  --sample <n>        simulate one in n cache sets, estimate the miss rate (default: 1)\n"
+        "  --sample-validate   simulate every set, compare the estimate of --sample with it\n";
+
 int sc_main(int argc, char *argv[]) {
     try {
         // Get the tracefile argument and create Tracefile object
         // This function sets tracefile_ptr and num_cpus
         init_tracefile(&argc, &argv);
 
+        // The options follow the tracefile, argv[argc - 1] is the last one.
+        unsigned long sample_ratio = 1;
+        bool sample_validate = false;
+        for (int i = 0; i < argc - 1; i++) {
+            if (!strcmp(argv[i], "--sample") && i + 1 < argc - 1) {
+                char *end = nullptr;
+                sample_ratio = strtoul(argv[++i], &end, 10);
+                if (*end != '\0' || sample_ratio == 0) {
+                    throw runtime_error(string("Error, --sample expects a positive number\n") + usage);
+                }
+            } else if (!strcmp(argv[i], "--sample-validate")) {
+                sample_validate = true;
+            } else {
+                throw runtime_error(string("Error, unknown option: ") + argv[i] + "\n" + usage);
+            }
+        }
+        if (sample_validate && sample_ratio == 1) {
+            throw runtime_error(string("Error, --sample-validate needs a --sample above 1\n") + usage);
+        }
+
         // Initialize statistics counters
         stats_init();
+        if (sample_ratio > 1) {
+            sample_init(NR_SETS, (uint32_t) sample_ratio, sample_validate);
+        }
 
         // Instantiate Modules
         Cache mem("main_memory");
@@ -264,6 +305,9 @@ int sc_main(int argc, char *argv[]) {
 
         // Print statistics after simulation finished
         stats_print();
+        if (sample_ratio > 1) {
+            sample_print();
+        }
         // mem.dump(); // Uncomment to dump memory to stdout.
     }
 
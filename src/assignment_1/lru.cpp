@@ -62,10 +62,12 @@ uint32_t LRU::read(uint64_t tag) {
              << setfill('0') << setw(13) << right << hex << tag << endl;
 
         stats_readhit(0);
+        sample_access(0, this->lru_index, true);
         this->push2head(curr);
     } else {
         // cache miss.
         stats_readmiss(0);
+        sample_access(0, this->lru_index, false);
         cout << sc_time_stamp() << " read data from memory" << endl;
         sc_core::wait(100); // read data from memory.
 
@@ -130,6 +132,7 @@ void LRU::write(uint64_t tag, uint32_t _data) {
 
         // cache hits.
         stats_writehit(0);
+        sample_access(0, this->lru_index, true);
         cout << sc_core::sc_time_stamp() << " mark " << to_string(curr->index) << "th cache line as dirty" << endl;
         curr->dirty = true;
         curr->valid = true;
@@ -137,6 +140,7 @@ void LRU::write(uint64_t tag, uint32_t _data) {
     } else {
         // cache miss.
         stats_writemiss(0);
+        sample_access(0, this->lru_index, false);
         // allocate on write.
         sc_core::wait(100);
 
@@ -0,0 +1,185 @@
+//
+// Created by yanghoo on 3/4/24.
+//
+#include "Arbiter.h"
+#include <cstdio>
+
+using namespace std;
+
+Arbiter::Arbiter(uint32_t num_caches, size_t queue_capacity, uint32_t age_limit) {
+    this->num_caches = num_caches;
+    this->num_requesters = num_caches + 1;
+    this->age_limit = age_limit;
+
+    this->queues = vector<RingBuffer<entry>>(this->num_requesters, RingBuffer<entry>(queue_capacity));
+    this->arrivals = RingBuffer<arrival>(4 * this->num_requesters);
+    this->nonempty = vector<uint64_t>((this->num_requesters + 63) / 64, 0);
+    this->stats = vector<requester_stats>(this->num_requesters, requester_stats{0, 0, 0, 0, 0});
+}
+
+Arbiter *Arbiter::create(const sim_config &config, uint32_t num_caches) {
+    // A cache has at most one burst from the cpu side and a few data
+    // responses from the snooping side in flight.
+    const size_t queue_capacity = 4;
+
+    switch (config.arbiter) {
+        case fcfs:
+            return new FcfsArbiter(num_caches, queue_capacity, config.age_limit);
+        case round_robin:
+            return new RoundRobinArbiter(num_caches, queue_capacity, config.age_limit);
+        case memory_priority:
+            return new MemoryPriorityArbiter(num_caches, queue_capacity, config.age_limit);
+        case age_based:
+            return new AgeBasedArbiter(num_caches, queue_capacity, config.age_limit);
+        case weighted_fair:
+            return new WeightedFairArbiter(num_caches, queue_capacity, config.age_limit, config.memory_weight);
+    }
+    return nullptr;
+}
+
+void Arbiter::push(request_id id, uint64_t cycle) {
+    uint32_t requester = this->requester_of(id);
+    RingBuffer<entry> &queue = this->queues[requester];
+
+    if (queue.full()) {
+        this->stats[requester].overflows += 1;
+        queue.grow();
+    }
+    if (this->arrivals.full()) {
+        this->compact_arrivals();
+    }
+
+    uint64_t seq = this->next_seq++;
+    queue.push(entry{id, cycle, seq});
+    this->arrivals.push(arrival{requester, seq});
+    this->nonempty[requester / 64] |= 1ULL << (requester % 64);
+    this->pending += 1;
+}
+
+request_id Arbiter::grant(uint64_t cycle) {
+    uint32_t requester = this->select(cycle);
+    RingBuffer<entry> &queue = this->queues[requester];
+
+    entry granted = queue.front();
+    queue.pop();
+    if (queue.empty()) {
+        this->nonempty[requester / 64] &= ~(1ULL << (requester % 64));
+    }
+    this->pending -= 1;
+
+    uint64_t wait = cycle - granted.cycle;
+    requester_stats &stat = this->stats[requester];
+    stat.grants += 1;
+    stat.total_wait += wait;
+    if (wait > stat.max_wait) {
+        stat.max_wait = wait;
+    }
+    if (wait >= this->age_limit) {
+        stat.starved += 1;
+    }
+    return granted.id;
+}
+
+uint32_t Arbiter::oldest() {
+    // Drop the arrivals that were already granted by another policy decision.
+    while (this->is_served(this->arrivals.front())) {
+        this->arrivals.pop();
+    }
+    return this->arrivals.front().requester;
+}
+
+uint32_t Arbiter::next_nonempty(uint32_t from) const {
+    size_t words = this->nonempty.size();
+    size_t word = from / 64;
+    // Mask out the requesters before `from` in the first word.
+    uint64_t bits = this->nonempty[word] & (~0ULL << (from % 64));
+
+    for (size_t i = 0; i <= words; i++) {
+        if (bits != 0) {
+            return (uint32_t) (word * 64 + __builtin_ctzll(bits));
+        }
+        word = (word + 1) % words;
+        bits = this->nonempty[word];
+    }
+    return from;
+}
+
+void Arbiter::compact_arrivals() {
+    // In place: every arrival leaves the front before the live ones go
+    // back in at the end, in the same order.
+    for (size_t i = this->arrivals.size(); i > 0; i--) {
+        arrival a = this->arrivals.front();
+        this->arrivals.pop();
+        if (!this->is_served(a)) {
+            this->arrivals.push(a);
+        }
+    }
+    // Keep at least half of the buffer free so compaction stays amortized O(1).
+    if (this->arrivals.size() * 2 > this->arrivals.capacity()) {
+        this->arrivals.grow();
+    }
+}
+
+void Arbiter::print_stats(std::ostream &os) const {
+    os << "Arbiter: " << this->name() << endl;
+    os << "Requester\tGrants\tAvgWait\t\tMaxWait\tStarved\tOverflow" << endl;
+
+    char line[128];
+    for (uint32_t i = 0; i < this->num_requesters; i++) {
+        const requester_stats &stat = this->stats[i];
+        double avg_wait = stat.grants ? (double) stat.total_wait / (double) stat.grants : 0;
+        string requester = i == this->memory_requester() ? "memory" : "cache " + to_string(i);
+
+        snprintf(line, sizeof(line), "%s\t\t%lu\t%f\t%lu\t%lu\t%lu", requester.c_str(),
+                 (unsigned long) stat.grants, avg_wait, (unsigned long) stat.max_wait,
+                 (unsigned long) stat.starved, (unsigned long) stat.overflows);
+        os << line << endl;
+    }
+}
+
+uint32_t FcfsArbiter::select(uint64_t cycle) {
+    return this->oldest();
+}
+
+uint32_t RoundRobinArbiter::select(uint64_t cycle) {
+    this->last = this->next_nonempty((this->last + 1) % this->num_requesters);
+    return this->last;
+}
+
+uint32_t MemoryPriorityArbiter::select(uint64_t cycle) {
+    if (this->has_pending(this->memory_requester())) {
+        return this->memory_requester();
+    }
+    return this->oldest();
+}
+
+uint32_t AgeBasedArbiter::select(uint64_t cycle) {
+    uint32_t oldest = this->oldest();
+    // Memory goes first, unless that would starve a cache any longer.
+    if (cycle - this->head(oldest).cycle >= this->age_limit) {
+        return oldest;
+    }
+    if (this->has_pending(this->memory_requester())) {
+        return this->memory_requester();
+    }
+    return oldest;
+}
+
+WeightedFairArbiter::WeightedFairArbiter(uint32_t num_caches, size_t queue_capacity, uint32_t age_limit,
+                                         uint32_t memory_weight)
+        : Arbiter(num_caches, queue_capacity, age_limit) {
+    this->weights = vector<uint32_t>(this->num_requesters, 1);
+    this->weights[this->memory_requester()] = memory_weight > 0 ? memory_weight : 1;
+}
+
+uint32_t WeightedFairArbiter::select(uint64_t cycle) {
+    // Deficit round robin: the current requester keeps the bus until its
+    // quantum is used up or its queue runs dry.
+    if (this->deficit > 0 && this->has_pending(this->current)) {
+        this->deficit -= 1;
+        return this->current;
+    }
+    this->current = this->next_nonempty((this->current + 1) % this->num_requesters);
+    this->deficit = this->weights[this->current] - 1;
+    return this->current;
+}
@@ -0,0 +1,178 @@
+//
+// Created by yanghoo on 3/4/24.
+//
+
+#ifndef FRAMEWORK_ARBITER_H
+#define FRAMEWORK_ARBITER_H
+
+#include <iostream>
+#include <vector>
+#include "config.h"
+#include "ring_buffer.h"
+#include "types.h"
+
+/*
+ * Bus arbitration. Every requester has its own ring buffer, requester i is
+ * cache i and requester num_caches is the memory. A policy only decides
+ * which non-empty queue gets the next grant.
+ */
+class Arbiter {
+public:
+    Arbiter(uint32_t num_caches, size_t queue_capacity, uint32_t age_limit);
+
+    virtual ~Arbiter() = default;
+
+    static Arbiter *create(const sim_config &config, uint32_t num_caches);
+
+    // A full queue is grown, which is counted as an overflow in the stats.
+    void push(request_id id, uint64_t cycle);
+
+    // Pops the request picked by the policy, the arbiter must not be empty.
+    request_id grant(uint64_t cycle);
+
+    bool empty() const {
+        return this->pending == 0;
+    }
+
+    virtual const char *name() const = 0;
+
+    // Queueing delay and starvation per requester.
+    void print_stats(std::ostream &os) const;
+
+protected:
+    typedef struct entry {
+        request_id id;
+        uint64_t cycle; // cycle it was queued.
+        uint64_t seq;   // global arrival number.
+    } entry;
+
+    // Returns a requester with a non-empty queue.
+    virtual uint32_t select(uint64_t cycle) = 0;
+
+    uint32_t memory_requester() const {
+        return this->num_caches;
+    }
+
+    bool has_pending(uint32_t requester) const {
+        return !this->queues[requester].empty();
+    }
+
+    const entry &head(uint32_t requester) const {
+        return this->queues[requester].front();
+    }
+
+    // The requester that holds the oldest pending request.
+    uint32_t oldest();
+
+    // First requester at or after `from` (wrapping around) with a pending request.
+    uint32_t next_nonempty(uint32_t from) const;
+
+    uint32_t num_caches;
+    uint32_t num_requesters;
+    uint32_t age_limit;
+
+private:
+    typedef struct arrival {
+        uint32_t requester;
+        uint64_t seq;
+    } arrival;
+
+    typedef struct requester_stats {
+        uint64_t grants;
+        uint64_t total_wait;
+        uint64_t max_wait;
+        uint64_t starved;
+        uint64_t overflows;
+    } requester_stats;
+
+    uint32_t requester_of(request_id id) const {
+        return id.source == location::memory ? this->num_caches : id.cpu_id;
+    }
+
+    bool is_served(const arrival &a) const {
+        const RingBuffer<entry> &queue = this->queues[a.requester];
+        return queue.empty() || queue.front().seq > a.seq;
+    }
+
+    void compact_arrivals();
+
+    std::vector<RingBuffer<entry>> queues;
+    // Arrival order over all queues. Entries that were granted out of order
+    // stay behind and are skipped when they reach the front.
+    RingBuffer<arrival> arrivals;
+    // One bit per requester, set while its queue is non-empty.
+    std::vector<uint64_t> nonempty;
+    std::vector<requester_stats> stats;
+    uint64_t next_seq = 0;
+    size_t pending = 0;
+};
+
+class FcfsArbiter : public Arbiter {
+public:
+    using Arbiter::Arbiter;
+
+    const char *name() const override {
+        return arbiter_name(arbiter_policy::fcfs);
+    }
+
+protected:
+    uint32_t select(uint64_t cycle) override;
+};
+
+class RoundRobinArbiter : public Arbiter {
+public:
+    using Arbiter::Arbiter;
+
+    const char *name() const override {
+        return arbiter_name(arbiter_policy::round_robin);
+    }
+
+protected:
+    uint32_t select(uint64_t cycle) override;
+
+private:
+    uint32_t last = 0;
+};
+
+class MemoryPriorityArbiter : public Arbiter {
+public:
+    using Arbiter::Arbiter;
+
+    const char *name() const override {
+        return arbiter_name(arbiter_policy::memory_priority);
+    }
+
+protected:
+    uint32_t select(uint64_t cycle) override;
+};
+
+class AgeBasedArbiter : public Arbiter {
+public:
+    using Arbiter::Arbiter;
+
+    const char *name() const override {
+        return arbiter_name(arbiter_policy::age_based);
+    }
+
+protected:
+    uint32_t select(uint64_t cycle) override;
+};
+
+class WeightedFairArbiter : public Arbiter {
+public:
+    WeightedFairArbiter(uint32_t num_caches, size_t queue_capacity, uint32_t age_limit, uint32_t memory_weight);
+
+    const char *name() const override {
+        return arbiter_name(arbiter_policy::weighted_fair);
+    }
+
+protected:
+    uint32_t select(uint64_t cycle) override;
+
+private:
+    std::vector<uint32_t> weights;
+    uint32_t current = 0;
+    uint32_t deficit = 0;
+};
+
+#endif //FRAMEWORK_ARBITER_H
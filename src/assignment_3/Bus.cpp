@@ -4,12 +4,44 @@
 #include "Bus.h"
 
 int Bus::try_request(request_id req) {
-    this->requests.push_back(req);
+    this->arbiter->push(req, current_cycle());
+    this->wake.notify(SC_ZERO_TIME);
     return 0;
 }
 
+uint64_t Bus::next_work(uint64_t cycle) const {
+    if (!this->arbiter->empty()) {
+        return cycle + 1;
+    }
+    uint64_t next = UINT64_MAX;
+    if (!this->data_phases.empty()) {
+        next = this->data_phases.front().end;
+    }
+    if (!this->snoops.empty()) {
+        next = min(next, this->snoops.front().ready);
+    }
+    return next;
+}
+
+void Bus::schedule() {
+    uint64_t cycle = current_cycle();
+    uint64_t next = this->next_work(cycle);
+    // The static sensitivity is the negative edge.
+    if (next <= cycle + 1) {
+        next_trigger();
+        return;
+    }
+    if (next != UINT64_MAX) {
+        // Half a cycle early, the negative edge after it is the one of `next`.
+        this->wake.notify(cycles(next - cycle) - cycles(1) / 2);
+    }
+    this->phase = phase_type::woken;
+    next_trigger(this->wake);
+}
+
 location Bus::recent_data_location(uint64_t addr) {
-    for (uint32_t i = 0; i < this->caches.size(); i++) {
+    this->snoop_filter.sharers(addr, this->snoop_targets);
+    for (uint32_t i : this->snoop_targets) {
         cache_status status;
         if (this->caches[i]->get_cacheline_status(addr, &status)) {
             if (status != cache_status::invalid) {
@@ -20,30 +52,77 @@ location Bus::recent_data_location(uint64_t addr) {
     return location::memory;
 }
 
-void Bus::send_request(request req) {
+location Bus::resolve_read(request req, bool speculated) {
     auto data_location = this->recent_data_location(req.addr);
-    bool exists = false;
+    this->caches[req.sender_id]->put_ack_from(data_location);
+
+    // The model checks the copy of the requester, which has no data during a
+    // miss, so the line comes from memory. With cache supply the copy of the
+    // holder is checked, a cache supplies the line when it has the data.
+    int checked = this->cache_supply ? find_most_recent_data_holder(req.addr) : req.sender_id;
+    if (!this->caches[checked]->has_data(req.addr)) {
+        data_location = location::memory;
+    }
+    switch (data_location) {
+        case location::memory:
+            log(this->name(), "go to mem");
+            this->send_to_cpus(req);
+            if (!speculated) {
+                this->send_to_mem(req);
+            }
+            break;
+        default:
+            log(this->name(), "go to cpu");
+            if (speculated) {
+                this->memory->cancel(req);
+                this->cancelled_reads += 1;
+            }
+            int cpu_id = find_most_recent_data_holder(req.addr);
+            req.op = op_type::data_transfer;
+            req.receiver_id = cpu_id;
+            this->send_to_cpus(req);
+            this->cache_supplied += 1;
+            break;
+    }
+    return data_location;
+}
+
+void Bus::resolve_snoops(uint64_t cycle) {
+    while (!this->snoops.empty() && this->snoops.front().ready <= cycle) {
+        pending_snoop snoop = this->snoops.front();
+        this->snoops.pop_front();
+        if (this->resolve_read(snoop.req, snoop.speculated) == location::memory && snoop.has_data) {
+            this->transfer_data(snoop.data);
+        }
+    }
+}
+
+bool Bus::hold_early_data(const request &req) {
+    for (auto &snoop : this->snoops) {
+        if (snoop.speculated && !snoop.has_data && snoop.req.sender_id == req.receiver_id
+            && snoop.req.addr == req.addr) {
+            snoop.has_data = true;
+            snoop.data = req;
+            return true;
+        }
+    }
+    return false;
+}
 
+void Bus::send_request(const request &req) {
     switch (req.op) {
         case probe_read:
-            this->caches[req.sender_id]->put_ack_from(data_location);
-
-            if (!this->caches[req.sender_id]->has_data(req.addr)) {
-                data_location = location::memory;
+            if (this->snoop_latency == 0) {
+                this->resolve_read(req, false);
+                break;
             }
-            switch (data_location) {
-                case location::memory:
-                    cout << "go to mem" << endl;
-                    this->send_to_cpus(req);
-                    this->send_to_mem(req);
-                    break;
-                default:
-                    cout << "go to cpu"  << endl;
-                    int cpu_id = find_most_recent_data_holder(req.addr);
-                    req.op = op_type::data_transfer;
-                    req.receiver_id = cpu_id;
-                    this->send_to_cpus(req);
-                    break;
+            // The caches answer after snoop_latency cycles.
+            this->snoops.push_back(pending_snoop{req, current_cycle() + this->snoop_latency,
+                                                 this->speculative_fetch, false, request()});
+            this->snooped_reads += 1;
+            if (this->speculative_fetch) {
+                this->memory->speculative_read(req);
+                this->speculative_reads += 1;
             }
             break;
 
@@ -52,52 +131,139 @@ void Bus::send_request(request req) {
             if (req.destination == location::all) {
                 log(this->name(), "send to all");
                 this->send_to_cpus(req); // Invalidate all the coherent cpus.
+                this->snoop_filter.invalidate_others(req.sender_id, req.addr);
             }
 
             if (req.destination == location::memory) {
+                // write back, the cache line goes over the data bus.
                 log(this->name(), "send to mem");
-                this->send_to_mem(req);
+                this->transfer_data(req);
             };
 
             break;
 
         case data_transfer:
             // read data from memory or cache.
+            if (req.source == location::memory && !this->snoops.empty() && this->hold_early_data(req)) {
+                break;
+            }
+            this->transfer_data(req);
+    }
+}
+
+void Bus::transfer_data(const request &req) {
+    if (!this->split_bus) {
+        this->finish_data_phase(req);
+        return;
+    }
+
+    // The data phase starts after the address phase of this cycle, once
+    // every data phase granted before it has left the data bus.
+    uint64_t cycle = current_cycle();
+    uint64_t start = max(cycle + 1, this->data_busy_until);
+    this->data_busy_until = start + this->data_beats;
+
+    if (this->data_phases.full()) {
+        this->data_phases.grow();
+    }
+    this->data_phases.push(data_phase{req, this->data_busy_until});
+
+    this->data_transfers += 1;
+    this->data_busy_cycles += this->data_beats;
+    this->data_wait_cycles += start - (cycle + 1);
+    this->peak_outstanding = max(this->peak_outstanding, this->data_phases.size());
+}
+
+void Bus::finish_data_phase(const request &req) {
+    switch (req.op) {
+        case data_transfer:
             this->send_data_to_cpu(req.receiver_id, req);
+            break;
+        case probe_write:
+            this->send_to_mem(req);
+            break;
+        default:
+            break;
+    }
+}
+
+void Bus::retire_data_phases(uint64_t cycle) {
+    // Data phases finish in order, they share one data bus.
+    while (!this->data_phases.empty() && this->data_phases.front().end <= cycle) {
+        this->finish_data_phase(this->data_phases.front().req);
+        this->data_phases.pop();
+    }
+}
+
+bool Bus::advance(uint64_t cycle) {
+    if (!this->split_bus) {
+        return true;
+    }
+    this->retire_data_phases(cycle);
+    return this->address_bus_ready(cycle);
+}
+
+bool Bus::address_bus_ready(uint64_t cycle) {
+    if (this->address_busy_until > cycle) {
+        return false;
     }
+    if (this->data_phases.size() >= this->max_outstanding) {
+        // A granted request could not get its data phase, hold the address bus.
+        if (!this->arbiter->empty()) {
+            this->address_stall_cycles += 1;
+        }
+        return false;
+    }
+    return true;
 }
 
 request_id Bus::get_next_request_id() {
-    uint32_t request_i = 0;
+    return this->arbiter->grant(current_cycle());
+}
 
-    for (uint32_t i = 0; i < this->requests.size(); i++) {
-        if (this->requests[request_i].source == location::memory) {
-            request_i = i;
-            break;
+void Bus::print_stats() const {
+    cout << this->name() << endl;
+    this->arbiter->print_stats(cout);
+
+    if (this->snoop_latency > 0 || this->cache_supply) {
+        printf("Snoops: %u cycle(s), %lu read(s), %lu supplied by a cache", this->snoop_latency,
+               (unsigned long) this->snooped_reads, (unsigned long) this->cache_supplied);
+        if (this->speculative_fetch) {
+            printf(", %lu speculative memory read(s), %lu cancelled", (unsigned long) this->speculative_reads,
+                   (unsigned long) this->cancelled_reads);
         }
+        printf("\n");
     }
-    auto req = this->requests[request_i];
-    this->requests.erase(this->requests.begin() + request_i);
 
-    return req;
+    if (!this->split_bus) {
+        return;
+    }
+    double cycles = sc_time_stamp().to_default_time_units();
+    printf("Split bus: %lu beat(s) per line, %u outstanding\n", (unsigned long) this->data_beats,
+           this->max_outstanding);
+    printf("AddrBusy\tAddrUtil\tDataBusy\tDataUtil\tTransfers\tAvgDataWait\tPeakOutst\tAddrStalls\n");
+    printf("%lu\t\t%f\t%lu\t\t%f\t%lu\t\t%f\t%lu\t\t%lu\n",
+           (unsigned long) this->address_busy_cycles, cycles > 0 ? this->address_busy_cycles / cycles : 0,
+           (unsigned long) this->data_busy_cycles, cycles > 0 ? this->data_busy_cycles / cycles : 0,
+           (unsigned long) this->data_transfers,
+           this->data_transfers ? (double) this->data_wait_cycles / (double) this->data_transfers : 0,
+           (unsigned long) this->peak_outstanding, (unsigned long) this->address_stall_cycles);
 }
 
-void Bus::send_to_cpus(request req) {
-    // mark all the cpus are allowed to wake up.
-    for (uint32_t i = 0; i < this->caches.size(); i++) {
-        // log(this->name(), "send to", to_string(i), "receiver: ", to_string(req.receiver_id), "size", to_string(this->caches.size()));
-        // log(this->name(), "sender", to_string(req.sender_id));
+void Bus::send_to_cpus(const request &req) {
+    // Snoop the other caches that have the line directly, no cache process
+    // is woken up.
+    this->snoop_filter.sharers(req.addr, this->snoop_targets);
+    for (uint32_t i : this->snoop_targets) {
         if (i == req.sender_id) {
             continue;
         } else {
-            caches[i]->send_new_event();
+            caches[i]->snoop(req);
         }
     }
-    // wake up all the cpus.
-    this->CachePort.write(req);
 }
 
-void Bus::send_to_mem(request req) {
+void Bus::send_to_mem(const request &req) {
     // write miss is replaced by read miss + write hit.
     switch (req.op) {
         case probe_read:
@@ -112,14 +278,15 @@ void Bus::send_to_mem(request req) {
     log(this->name(), "write finish.");
 }
 
-void Bus::send_data_to_cpu(int cpu_id, request req) {
+void Bus::send_data_to_cpu(int cpu_id, const request &req) {
     // Only wake up the specific CPU.
     this->caches[cpu_id]->send_data(req);
 }
 
 int Bus::find_most_recent_data_holder(uint64_t addr) {
     // Any caches that are not invalid will hold the most recent data.
-    for (uint32_t i = 0; i < this->caches.size(); i++) {
+    this->snoop_filter.sharers(addr, this->snoop_targets);
+    for (uint32_t i : this->snoop_targets) {
         cache_status status;
         if (this->caches[i]->get_cacheline_status(addr, &status)) {
             if (status != cache_status::invalid) {
@@ -130,13 +297,7 @@ int Bus::find_most_recent_data_holder(uint64_t addr) {
     return 0;
 }
 
-void Bus::send_data_request_to_cpu(int cpu_id, request req) {
-    // Only wake up the receiver cpu.
-    for (uint32_t i = 0; i < this->caches.size(); i++) {
-        if ((int) i == cpu_id) {
-            caches[i]->send_new_event();
-        }
-    }
-    // wake up all the cpus.
-    this->CachePort.write(req);
+void Bus::send_data_request_to_cpu(int cpu_id, const request &req) {
+    // Only the receiver cpu snoops it.
+    this->caches[cpu_id]->snoop(req);
 }
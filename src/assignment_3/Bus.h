@@ -5,9 +5,15 @@
 #define FRAMEWORK_BUS_H
 #include "psa.h"
 #include "types.h"
+#include "Arbiter.h"
+#include "config.h"
 #include "bus_if.h"
 #include "Memory_if.h"
 #include "cache_if.h"
+#include "lru.h"
+#include "ring_buffer.h"
+#include "SnoopFilter.h"
+#include <deque>
 #include <systemc.h>
 #include "helpers.h"
 
@@ -15,73 +21,212 @@ class Bus : public bus_if, public sc_module {
 public:
     sc_port<Memory_if> memory;
     sc_in_clk clock;
-    std::vector<sc_port<cache_if>> caches;
-    sc_out<request> CachePort;
+    sc_port<cache_if, 0> caches; // one binding per cache, in cpu id order.
 
     int try_request(request_id) override;
 
+    void add_sharer(uint32_t cpu_id, uint64_t addr) override {
+        this->snoop_filter.add(cpu_id, addr);
+    }
+
+    void remove_sharer(uint32_t cpu_id, uint64_t addr) override {
+        this->snoop_filter.remove(cpu_id, addr);
+    }
+
     location recent_data_location(uint64_t addr);
 
-    void send_data_to_cpu(int cpu_id, request req);
+    void send_data_to_cpu(int cpu_id, const request &req);
 
-    void send_to_mem(request req);
+    void send_to_mem(const request &req);
 
-    void send_to_cpus(request req);
+    virtual void send_to_cpus(const request &req);
 
-    void send_data_request_to_cpu(int cpu_id, request req);
+    void send_data_request_to_cpu(int cpu_id, const request &req);
 
     int find_most_recent_data_holder(uint64_t addr);
 
     request_id get_next_request_id();
 
-    void send_request(request);
+    void send_request(const request &req);
+
+    // Moves a cache line, either right away or through the data bus.
+    virtual void transfer_data(const request &req);
+
+    virtual void print_stats() const;
 
     // Constructor without SC_ macro.
-    Bus(sc_module_name name_) : sc_module(name_) {
-        SC_THREAD(execute);
-        this->caches = std::vector<sc_port<cache_if>>(num_cpus);
+    Bus(sc_module_name name_, const SimulationContext &context_, const sim_config &config, uint32_t bus_id_)
+            : sc_module(name_), context(context_), bus_id(bus_id_), snoop_filter(context_.num_cpus) {
+        SC_METHOD(execute);
+        this->arbiter = Arbiter::create(config, context.num_cpus);
+
+        this->split_bus = config.split_bus;
+        this->data_beats = (BLOCK_SIZE + config.bus_width - 1) / config.bus_width;
+        this->max_outstanding = config.max_outstanding;
+        this->data_phases = RingBuffer<data_phase>(config.max_outstanding);
+        this->snoop_latency = config.snoop_latency;
+        this->speculative_fetch = config.speculative_fetch;
+        this->cache_supply = config.cache_supply;
         sensitive << clock.neg();
         dont_initialize(); // don't call execute to initialise it.
     }
 
     SC_HAS_PROCESS(Bus); // Needed because we didn't use SC_TOR
 
-    ~Bus() {
+    ~Bus() override {
+        delete this->arbiter;
     }
 
+    // A method process, every activation is one step of the state machine
+    // and sets the trigger of the next one.
     void execute() {
-        while (true) {
-            wait();
-            if (this->requests.empty()) {
-                continue;
-            } else {
-                // there are requests in the queue, fetching the requests.
-                auto req = this->get_next_request_id();
-                vector<request> buffer;
-
-                switch (req.source) {
-                    case location::memory:
-                        buffer = this->memory->get_requests();
-                        this->memory->ack();
-                        break;
-                    case location::cache:
-                        buffer = this->caches[req.cpu_id]->get_requests();
-                        this->caches[req.cpu_id]->ack();
-                        break;
-                    default:
-                        break;
-                }
-
-                log(this->name(), "process data");
-                for (auto req_in_buffer : buffer) {
-                    this->send_request(req_in_buffer);
-                }
+        switch (this->phase) {
+            case phase_type::starting:
+                // The first negative edge only schedules.
+                this->phase = phase_type::active;
+                break;
+            case phase_type::woken:
+                // Woken half a cycle early, the negative edge is next.
+                this->phase = phase_type::active;
+                next_trigger();
+                return;
+            case phase_type::active:
+                this->arbitrate(current_cycle());
+                break;
+        }
+        this->schedule();
+    }
+
+    void arbitrate(uint64_t cycle) {
+        this->resolve_snoops(cycle);
+        if (!this->advance(cycle)) {
+            return;
+        }
+
+        if (this->arbiter->empty()) {
+            return;
+        } else {
+            // there are requests in the queue, fetching the requests.
+            auto req = this->get_next_request_id();
+            RingBuffer<request> *buffer = nullptr;
+
+            switch (req.source) {
+                case location::memory:
+                    buffer = &this->memory->send_buffer(this->bus_id);
+                    this->memory->ack(this->bus_id);
+                    break;
+                case location::cache:
+                    buffer = &this->caches[req.cpu_id]->send_buffer(this->bus_id);
+                    this->caches[req.cpu_id]->ack();
+                    break;
+                default:
+                    break;
             }
+
+            // The burst is what the link holds now, in place: the requests
+            // it causes go to the links of other caches.
+            log(this->name(), "process data");
+            size_t burst = buffer == nullptr ? 0 : buffer->size();
+            for (size_t i = 0; i < burst; i++) {
+                this->send_request(buffer->front());
+                buffer->pop();
+            }
+            // Every request of the burst takes one address cycle.
+            uint64_t address_cycles = burst == 0 ? 1 : burst;
+            this->address_busy_until = cycle + address_cycles;
+            this->address_busy_cycles += address_cycles;
         }
     }
 
+protected:
+    const SimulationContext &context;
+    // Index of this bus, it snoops the lines that line_interleave maps to it.
+    uint32_t bus_id;
+    // The caches a snoop of a line visits, see SnoopFilter.
+    SnoopFilter snoop_filter;
+    std::vector<uint32_t> snoop_targets;
+    Arbiter *arbiter;
+    // Notified by new requests, and timed for the next data phase or snoop.
+    sc_event wake;
+
+    // Called every cycle before arbitration, returns false while no new
+    // request can be granted.
+    virtual bool advance(uint64_t cycle);
+
+    // The next cycle the bus has something to do, UINT64_MAX if it waits
+    // for a request.
+    virtual uint64_t next_work(uint64_t cycle) const;
+
+    // Delivers a cache line that finished its transfer.
+    void finish_data_phase(const request &req);
+
+    static uint64_t current_cycle() {
+        return (uint64_t) sc_time_stamp().to_default_time_units();
+    }
+
 private:
-    bus_requests requests;
+    // Split transaction model, see transfer_data.
+    typedef struct data_phase {
+        request req;
+        uint64_t end; // cycle the last beat is on the bus.
+    } data_phase;
+
+    bool split_bus;
+    uint64_t data_beats;
+    uint32_t max_outstanding;
+    RingBuffer<data_phase> data_phases;
+    uint64_t address_busy_until = 0;
+    uint64_t data_busy_until = 0;
+
+    uint64_t address_busy_cycles = 0;
+    uint64_t data_busy_cycles = 0;
+    uint64_t data_wait_cycles = 0;
+    uint64_t data_transfers = 0;
+    uint64_t address_stall_cycles = 0;
+    size_t peak_outstanding = 0;
+
+    // A read waiting for the result of its snoop, see sim_config::snoop_latency.
+    typedef struct pending_snoop {
+        request req;
+        uint64_t ready;  // cycle the caches have answered.
+        bool speculated; // the memory read started with the snoop.
+        bool has_data;   // the speculative line came back before the answer.
+        request data;
+    } pending_snoop;
+
+    uint32_t snoop_latency;
+    bool speculative_fetch;
+    bool cache_supply;
+    std::deque<pending_snoop> snoops; // in grant order, so in ready order.
+    uint64_t snooped_reads = 0;
+    uint64_t cache_supplied = 0;
+    uint64_t speculative_reads = 0;
+    uint64_t cancelled_reads = 0;
+
+    // Sends a read to the cache that has the line or to the memory, unless
+    // its speculative memory read is on the way. Returns where the line
+    // comes from.
+    location resolve_read(request req, bool speculated);
+
+    void resolve_snoops(uint64_t cycle);
+
+    // Keeps a line of a speculative read until its snoop is answered.
+    bool hold_early_data(const request &req);
+
+    bool address_bus_ready(uint64_t cycle);
+
+    enum phase_type {
+        starting = 0, // before the first negative edge.
+        woken = 1,    // woken by `wake` at a positive edge.
+        active = 2,   // at a negative edge.
+    };
+    phase_type phase = phase_type::starting;
+
+    // Triggers the next negative edge that has work, idle cycles are
+    // skipped.
+    void schedule();
+
+    void retire_data_phases(uint64_t cycle);
 };
 
 #endif //FRAMEWORK_BUS_H
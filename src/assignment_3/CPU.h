@@ -7,12 +7,17 @@
 
 #include <iostream>
 #include <systemc.h>
+#include <tlm.h>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
 
+#include "Cache.h"
 #include "cache_if.h"
 #include "helpers.h"
 #include "psa.h"
 #include "types.h"
 #include "cpu_if.h"
+#include "lru.h"
 #include "Manager_if.h"
 
 class CPU: public sc_module {
@@ -21,8 +26,12 @@ public:
     sc_in<bool> start;
     sc_port<cache_if> cache;
     sc_port<Manager_if> manager;
+    // The loosely timed path to the cache, bound in both modes.
+    tlm_utils::simple_initiator_socket<CPU> socket;
 
-    CPU(sc_module_name name_, int id_) : sc_module(name_), id(id_) {
+    CPU(sc_module_name name_, SimulationContext &context_, int id_, bool loosely_timed_)
+            : sc_module(name_), socket("socket"), context(context_), id(id_), loosely_timed(loosely_timed_) {
+        this->socket.register_invalidate_direct_mem_ptr(this, &CPU::invalidate_direct_mem_ptr);
         SC_THREAD(execute);
         sensitive << clock.pos();
         log(name(), "constructed with id", id);
@@ -32,28 +41,59 @@ public:
     SC_HAS_PROCESS(CPU); // Needed because we didn't use SC_TOR
 
 private:
+    SimulationContext &context;
     int id;
+    // Loosely timed, the processor runs ahead of the clock on hits and only
+    // synchronizes when its quantum is used up or the cache needs the bus.
+    bool loosely_timed;
+    tlm_utils::tlm_quantumkeeper keeper;
+    // Lines the cache handed out for direct access, SET_SIZE per set like
+    // in the cache: line + 1, 0 for a free way.
+    typedef struct direct_line {
+        uint64_t line;
+        bool writable;
+    } direct_line;
+    direct_line direct_lines[NR_SETS * SET_SIZE] = {};
+    sc_time direct_latency;
+    unsigned char data[8];
 
     void execute() {
         wait(this->start.value_changed_event());
         if (!this->start.read()) return;
+        this->keeper.reset();
 
         TraceFile::Entry tr_data;
         // Loop until end of tracefile
-        while (!tracefile_ptr->eof()) {
+        while (!this->context.tracefile->eof()) {
+            if (this->manager->checkpoint_due(this->local_cycle())) {
+                if (this->loosely_timed) {
+                    this->keeper.sync();
+                }
+                log(this->name(), "stopped for the checkpoint");
+                this->manager->park();
+                return;
+            }
             // Get the next action for the processor in the trace
-            if (!tracefile_ptr->next(this->id, tr_data)) {
+            if (!this->context.tracefile->next(this->id, tr_data)) {
                 cerr << "Error reading trace for Manager" << endl;
                 break;
             }
             switch (tr_data.type) {
                 case TraceFile::ENTRY_TYPE_READ:
                     log_addr(name(), "[READ] ", tr_data.addr);
+                    if (this->loosely_timed) {
+                        this->transport(tr_data.addr, false);
+                        break;
+                    }
                     this->cache->cpu_read(tr_data.addr);
                     log_addr(name(), "[READ END] ", tr_data.addr);
                     break;
                 case TraceFile::ENTRY_TYPE_WRITE:
                     log_addr(name(), "[WRITE]", tr_data.addr);
+                    if (this->loosely_timed) {
+                        this->transport(tr_data.addr, true);
+                        break;
+                    }
                     this->cache->cpu_write(tr_data.addr);
                     log_addr(name(), "[WRITE END]", tr_data.addr);
                     break;
@@ -64,12 +104,104 @@ private:
                     cerr << "Error, got invalid data from Trace" << endl;
                     exit(0);
             }
-            wait();
+            if (this->loosely_timed) {
+                this->keeper.inc(cycles(1));
+                if (this->keeper.need_sync()) {
+                    this->keeper.sync();
+                }
+            } else {
+                wait();
+            }
             // Finished the Tracefile, now stop the simulation
         }
+        if (this->loosely_timed) {
+            this->keeper.sync();
+        }
         log(this->name(), "finish");
         manager->finish();
     }
+
+    // The cycle of the processor, ahead of the clock when loosely timed.
+    uint64_t local_cycle() {
+        sc_time now = sc_time_stamp();
+        if (this->loosely_timed) {
+            now += this->keeper.get_local_time();
+        }
+        return (uint64_t) now.to_default_time_units();
+    }
+
+    // The way that holds `line` among the direct lines, with `free` a free
+    // way of its set instead, nullptr if none.
+    direct_line *find_direct(uint64_t line, bool free = false) {
+        direct_line *set = &this->direct_lines[line % NR_SETS * SET_SIZE];
+        uint64_t key = free ? 0 : line + 1;
+        for (size_t i = 0; i < SET_SIZE; i++) {
+            if (set[i].line == key) {
+                return &set[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // An access through the socket. A line the cache handed out is read or
+    // written without it, in local time like a hit, only its recency is
+    // passed on to the cache.
+    void transport(uint64_t addr, bool write) {
+        direct_line *direct = this->find_direct(addr / BLOCK_SIZE);
+        if (direct != nullptr && (!write || direct->writable)) {
+            if (write) {
+                this->context.stats_writehit(this->id);
+            } else {
+                this->context.stats_readhit(this->id);
+            }
+            this->context.sample_access(this->id, (addr >> 5) % NR_SETS, true);
+            this->cache->touch(addr);
+            this->keeper.inc(this->direct_latency);
+            return;
+        }
+
+        tlm::tlm_generic_payload trans;
+        trans.set_command(write ? tlm::TLM_WRITE_COMMAND : tlm::TLM_READ_COMMAND);
+        trans.set_address(addr);
+        trans.set_data_ptr(this->data);
+        trans.set_data_length(sizeof(this->data));
+        trans.set_streaming_width(sizeof(this->data));
+        trans.set_byte_enable_ptr(nullptr);
+        trans.set_dmi_allowed(false);
+        trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+        sc_time delay = this->keeper.get_local_time();
+        this->socket->b_transport(trans, delay);
+        this->keeper.set(delay);
+        if (trans.is_response_error()) {
+            cerr << "Error, the cache failed an access of " << this->name() << endl;
+            exit(0);
+        }
+
+        if (trans.is_dmi_allowed()) {
+            tlm::tlm_dmi dmi;
+            uint64_t line = addr / BLOCK_SIZE;
+            direct_line *direct = this->find_direct(line);
+            if (direct == nullptr) {
+                // The cache holds a set's lines at most, one of them is free.
+                direct = this->find_direct(line, true);
+            }
+            if (direct != nullptr && this->socket->get_direct_mem_ptr(trans, dmi)) {
+                *direct = direct_line{line + 1, dmi.is_write_allowed()};
+                this->direct_latency = dmi.get_read_latency();
+            }
+        }
+    }
+
+    // The cache took the lines back, a snoop or an eviction.
+    void invalidate_direct_mem_ptr(sc_dt::uint64 start, sc_dt::uint64 end) {
+        for (uint64_t line = start / BLOCK_SIZE; line <= end / BLOCK_SIZE; line++) {
+            direct_line *direct = this->find_direct(line);
+            if (direct != nullptr) {
+                direct->line = 0;
+            }
+        }
+    }
 };
 
 #endif //FRAMEWORK_CPU_H
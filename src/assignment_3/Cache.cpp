@@ -7,6 +7,10 @@
  */
 int Cache::cpu_read(uint64_t addr) {
     uint64_t set_i = (addr >> 5) % NR_SETS;
+    // Set sampling does not simulate the set, the access is a NOP.
+    if (this->context.sample_skips(set_i)) {
+        return 0;
+    }
     Set *set = &this->sets[set_i];
     LRU *lru = set->lru;
     lru_read(addr, (uint32_t) this->id, lru);
@@ -15,20 +19,117 @@ int Cache::cpu_read(uint64_t addr) {
 
 int Cache::cpu_write(uint64_t addr) {
     uint64_t set_i = (addr >> 5) % NR_SETS;
+    if (this->context.sample_skips(set_i)) {
+        return 0;
+    }
     Set *set = &this->sets[set_i];
     LRU *lru = set->lru;
     lru_write(addr, (uint32_t) this->id, lru);
     return 0;
 }
 
-int Cache::send_new_event() {
-    this->has_new_event = true;
-    return 0;
+void Cache::touch(uint64_t addr) {
+    LRU *lru = this->sets[(addr >> 5) % NR_SETS].lru;
+    LRUnit *curr = lru->find((addr >> 5) / NR_SETS);
+    if (curr != nullptr) {
+        lru->push2head(curr);
+    }
+}
+
+/* Loosely timed access of the processor.
+ * Hits without a bus transaction only add the hit to the local time of the
+ * processor: reads, and writes of a modified line, which no other cache
+ * has. Everything else waits until the clock caught up with the processor
+ * and takes the cycle accurate path.
+ */
+void Cache::b_transport(tlm::tlm_generic_payload &trans, sc_time &delay) {
+    uint64_t addr = trans.get_address();
+    bool write = trans.is_write();
+    uint64_t set_i = (addr >> 5) % NR_SETS;
+    trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    if (this->context.sample_skips(set_i)) {
+        trans.set_dmi_allowed(false);
+        return;
+    }
+    LRU *lru = this->sets[set_i].lru;
+    uint64_t tag = (addr >> 5) / NR_SETS;
+    LRUnit *curr = lru->find(tag);
+
+    if (curr != nullptr && (!write || curr->status == cache_status::modified)) {
+        if (write) {
+            this->context.stats_writehit(this->id);
+        } else {
+            this->context.stats_readhit(this->id);
+        }
+        this->context.sample_access(this->id, set_i, true);
+        lru->push2head(curr);
+        delay += cycles(1);
+    } else {
+        wait(delay);
+        delay = SC_ZERO_TIME;
+        if (write) {
+            this->cpu_write(addr);
+        } else {
+            this->cpu_read(addr);
+        }
+        curr = lru->find(tag);
+    }
+
+    bool owned_here = curr != nullptr
+            && (curr->status == cache_status::exclusive || curr->status == cache_status::modified);
+    trans.set_dmi_allowed(owned_here);
 }
 
-int Cache::send_data(request req) {
+bool Cache::get_direct_mem_ptr(tlm::tlm_generic_payload &trans, tlm::tlm_dmi &dmi) {
+    uint64_t addr = trans.get_address();
+    LRUnit *curr = this->sets[(addr >> 5) % NR_SETS].lru->find((addr >> 5) / NR_SETS);
+    if (curr == nullptr || (curr->status != cache_status::exclusive && curr->status != cache_status::modified)) {
+        return false;
+    }
+
+    uint64_t start = addr & ~(uint64_t) (BLOCK_SIZE - 1);
+    dmi.set_dmi_ptr(curr->data);
+    dmi.set_start_address(start);
+    dmi.set_end_address(start + BLOCK_SIZE - 1);
+    dmi.set_read_latency(cycles(1));
+    dmi.set_write_latency(cycles(1));
+    // An exclusive line becomes modified through the bus.
+    if (curr->status == cache_status::modified) {
+        dmi.allow_read_write();
+    } else {
+        dmi.allow_read();
+    }
+    return true;
+}
+
+void Cache::release_direct(uint64_t addr, const LRUnit *line) {
+    if (line->status != cache_status::exclusive && line->status != cache_status::modified) {
+        return;
+    }
+    uint64_t start = addr & ~(uint64_t) (BLOCK_SIZE - 1);
+    this->socket->invalidate_direct_mem_ptr(start, start + BLOCK_SIZE - 1);
+}
+
+void Cache::save(checkpoint::processor &state) const {
+    state.sets.clear();
+    for (size_t i = 0; i < NR_SETS; i++) {
+        state.sets.push_back(save_set(this->sets[i].lru));
+    }
+}
+
+void Cache::restore(const checkpoint::processor &state) {
+    if (state.sets.size() != NR_SETS) {
+        throw runtime_error("Error, the checkpoint is of a cache with another number of sets\n");
+    }
+    for (size_t i = 0; i < NR_SETS; i++) {
+        restore_set(this->sets[i].lru, state.sets[i]);
+    }
+}
+
+int Cache::send_data(const request &req) {
     this->data_ok = true;
     this->data = req;
+    this->data_event.notify(SC_ZERO_TIME);
 
     return 0;
 }
@@ -44,103 +145,82 @@ bool Cache::get_cacheline_status(uint64_t addr, cache_status *curr_status) {
     return exists;
 }
 
-void Cache::probe() {
-    while (true) {
-        wait(this->Port_Cache->value_changed_event());
-        auto event = Port_Cache.read();
-
-        if (!this->has_new_event) continue;
-        this->has_new_event = false;
-
-        uint64_t addr = event.addr;
-        uint64_t set_i = (addr >> 5) % NR_SETS;
-        uint64_t tag = (addr >> 5) / NR_SETS;
-
-        Set *set = &this->sets[set_i];
-        LRU *lru = set->lru;
-        cache_status curr_status;
-
-        bool exists = lru->get_status(tag, &curr_status);
-        if (!exists) continue;
-        request message = event;
-        auto curr = lru->find(tag);
-        cout << "get status in probing threads, size: " + to_string(lru->size);
-
-        switch (event.op) {
-            case data_transfer:
-                // Other caches try to read this cache line will trigger this code
-                // So the transition process is same as the probe_read, it doesn't have a break in the end.
-                if (event.receiver_id == this->id) {
-                    message.receiver_id = message.sender_id;
-                    message.sender_id = this->id;
-                    request_id rid;
-                    rid.source = location::cache;
-                    rid.cpu_id = this->id;
-
-                    this->send_buffer.push_back(message);
-                    this->bus_port->try_request(rid);
-                }
-            case probe_read:
-                // probe read hit.
-                switch (curr_status) {
-                    case exclusive:
-                        lru->find(tag)->status = cache_status::shared;
-                        log(this->name(), "[TRANSITION] From exclusive to shared,");
-                        break;
-                    case modified:
-                        lru->find(tag)->status = cache_status::owned;
-                        log(this->name(), "[TRANSITION] From modified to owned,");
-                        break;
-                    default:
-                        break;
-                }
-                break;
-
-            case probe_write:
-                // probe write hit.
-                cout << "write probe detected." << endl << endl;
-                switch (curr->status) {
-                    case invalid:
-                        break;
-                    case exclusive:
-                        log(this->name(), "[TRANSITION] From exclusive to invalid,");
-                        break;
-                    case shared:
-                        log(this->name(), "[TRANSITION] From shared to invalid,");
-                        break;
-                    case modified:
-                        log(this->name(), "[TRANSITION] From modified to invalid,");
-                        break;
-                    case owned:
-                        log(this->name(), "[TRANSITION] From owned to invalid,");
-                        break;
-                }
-                log(this->name(), "[INVALID Node]");
-                cout << endl;
-                log(this->name(), "[LRU size]", to_string(lru->size));
-                lru->invalid(lru->find(tag));
-                break;
-
-            default:
-                break;
-        }
+void Cache::snoop(const request &event) {
+    uint64_t addr = event.addr;
+    uint64_t set_i = (addr >> 5) % NR_SETS;
+    uint64_t tag = (addr >> 5) / NR_SETS;
+
+    Set *set = &this->sets[set_i];
+    LRU *lru = set->lru;
+    cache_status curr_status;
+
+    bool exists = lru->get_status(tag, &curr_status);
+    if (!exists) return;
+    request message = event;
+    auto curr = lru->find(tag);
+    // Every snoop ends the exclusive ownership of the line.
+    this->release_direct(addr, curr);
+
+    switch (event.op) {
+        case data_transfer:
+            // Other caches try to read this cache line will trigger this code
+            // So the transition process is same as the probe_read, it doesn't have a break in the end.
+            if (event.receiver_id == this->id) {
+                message.receiver_id = message.sender_id;
+                message.sender_id = this->id;
+                this->send_to_bus(message);
+            }
+        case probe_read:
+            // probe read hit.
+            switch (curr_status) {
+                case exclusive:
+                    lru->find(tag)->status = cache_status::shared;
+                    log(this->name(), "[TRANSITION] From exclusive to shared,");
+                    break;
+                case modified:
+                    lru->find(tag)->status = cache_status::owned;
+                    log(this->name(), "[TRANSITION] From modified to owned,");
+                    break;
+                default:
+                    break;
+            }
+            break;
+
+        case probe_write:
+            // probe write hit.
+            log(this->name(), "write probe detected");
+            switch (curr->status) {
+                case invalid:
+                    break;
+                case exclusive:
+                    log(this->name(), "[TRANSITION] From exclusive to invalid,");
+                    break;
+                case shared:
+                    log(this->name(), "[TRANSITION] From shared to invalid,");
+                    break;
+                case modified:
+                    log(this->name(), "[TRANSITION] From modified to invalid,");
+                    break;
+                case owned:
+                    log(this->name(), "[TRANSITION] From owned to invalid,");
+                    break;
+            }
+            log(this->name(), "[INVALID Node]");
+            log(this->name(), "[LRU size]", (unsigned) lru->size);
+            lru->invalid(lru->find(tag));
+            break;
+
+        default:
+            break;
     }
 }
 
 int Cache::ack() {
     this->ack_ok = true;
+    this->ack_event.notify(SC_ZERO_TIME);
     return 0;
 }
 
-std::vector<request> Cache::get_requests() {
-    vector<request> result;
-    for (const auto & i : this->send_buffer) {
-        result.push_back(i);
-    }
-    this->send_buffer.clear();
-    return result;
-}
-
 void Cache::lru_read(uint64_t addr, uint32_t cpuid, LRU* lru) {
     uint64_t tag = (addr >> 5) / NR_SETS;
     uint64_t set_i = (addr >> 5) % NR_SETS;
@@ -152,46 +232,50 @@ void Cache::lru_read(uint64_t addr, uint32_t cpuid, LRU* lru) {
 
         log_addr(this->name(), "[READ HIT]", addr);
 
-        stats_readhit(cpuid);
+        this->context.stats_readhit(cpuid);
+        this->context.sample_access(cpuid, set_i, true);
+        if (curr->status == cache_status::invalid) {
+            // A snoop took the line during the wait, push2head puts it back.
+            this->bus_of(addr)->add_sharer(this->id, addr);
+        }
         lru->push2head(curr);
     } else {
         // cache miss.
-        stats_readmiss(cpuid);
+        this->context.stats_readmiss(cpuid);
+        this->context.sample_access(cpuid, set_i, false);
         log_addr(this->name(), "[READ MISS]", addr);
 
         if (lru->is_full()) {
             // Cache line eviction.
-            cout << "ready to replace." << endl << endl;
+            log(this->name(), "ready to replace");
             curr = lru->tail;
-            if (lru->tail == nullptr) {
-                cout << "replace tail." << endl << endl;
-            }
-            cout << curr << endl;
 
             log_addr(this->name(), "[REPLACE ADDR]", addr);
 
             if (curr->status == cache_status::modified || curr->status == cache_status::owned) {
                 // update the memory data.
-                cout << "read curr." << endl << endl;
-                uint64_t cache_addr = (curr->tag << 12) + (set_i << 5);
-                cout << "send to mem." << endl << endl;
+                uint64_t cache_addr = (curr->tag * NR_SETS + set_i) << 5;
+                log(this->name(), "send to mem");
                 this->send_write_memory(cache_addr);
-                cout << "send to mem end." << endl << endl;
                 // Wait until the data is written into the memory.
                 this->wait_ack();
                 this->wait_data();
             }
 
             log_addr(this->name(), "[TRANSITION] Invalidate data", addr);
+            uint64_t victim = (curr->tag * NR_SETS + set_i) << 5;
+            this->release_direct(victim, curr);
             lru->invalid(curr);
+            this->bus_of(victim)->remove_sharer(this->id, victim);
             curr = lru->get_clean_node();
-
-            cout << "replace end." << endl << endl;
+            log(this->name(), "replace end");
         } else {
             curr = lru->get_clean_node();
             if (curr == nullptr) {
-                log(this->name(), "[LRU Size when reading]", to_string(lru->size));
-                cout << *lru;
+                log(this->name(), "[LRU Size when reading]", (unsigned) lru->size);
+                if (debug_log) {
+                    cout << *lru;
+                }
                 cout << "[ERROR]: find nullptr when get clean node." << endl;
                 return;
             }
@@ -203,7 +287,8 @@ void Cache::lru_read(uint64_t addr, uint32_t cpuid, LRU* lru) {
             curr->has_data = false;
             lru->push2head(curr);
             lru->size += 1;
-            cout << "send probe read." << endl << endl;
+            this->bus_of(addr)->add_sharer(this->id, addr);
+            log(this->name(), "send probe read");
 
             this->send_probe_read(addr);
             wait_ack();
@@ -224,9 +309,7 @@ void Cache::lru_read(uint64_t addr, uint32_t cpuid, LRU* lru) {
                     break;
             }
             // Start waiting.
-            cout << "waiting data." << endl << endl;
             wait_data(); // The data in this cache may be invalidated by other caches later.
-            cout << "waiting data end." << endl << endl;
             curr->has_data = true;
         }
     }
@@ -245,6 +328,10 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
 
         this->wait_ack();
 
+        if (curr->status == cache_status::invalid) {
+            // A snoop took the line during the wait, push2head puts it back.
+            this->bus_of(addr)->add_sharer(this->id, addr);
+        }
         if (curr->status == cache_status::shared) {
             log(this->name(), "[TRANSITION] From shared to modified.");
         } else {
@@ -253,15 +340,19 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
 
         curr->status = modified; // After invalidating all the caches, we can mark it as modified.
 
-        stats_writehit(cpuid);
+        this->context.stats_writehit(cpuid);
+        this->context.sample_access(cpuid, set_i, true);
         lru->push2head(curr);
     } else {
         // cache miss.
         log_addr(this->name(), "[WRITE MISS]", addr);
 
-        cout << *lru;
-        log(this->name(), "[LRU Size]", to_string(lru->size));
-        stats_writemiss(cpuid);
+        if (debug_log) {
+            cout << *lru;
+        }
+        log(this->name(), "[LRU Size]", (unsigned) lru->size);
+        this->context.stats_writemiss(cpuid);
+        this->context.sample_access(cpuid, set_i, false);
 
         if (lru->is_full()) {
             // Cache line eviction.
@@ -270,7 +361,7 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
                 // update the memory data.
 
                 log(this->name(), "replace");
-                uint64_t cache_addr = (curr->tag << 12) + (set_i << 5);
+                uint64_t cache_addr = (curr->tag * NR_SETS + set_i) << 5;
                 this->send_write_memory(cache_addr);
                 // Wait until the data is written into the memory.
                 this->wait_ack();
@@ -284,7 +375,10 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
                 // from this cache line.
             }
             log_addr(this->name(), "[TRANSITION] Invalidate data", addr);
+            uint64_t victim = (curr->tag * NR_SETS + set_i) << 5;
+            this->release_direct(victim, curr);
             lru->invalid(curr);
+            this->bus_of(victim)->remove_sharer(this->id, victim);
             curr = lru->get_clean_node();
 
         } else {
@@ -300,6 +394,7 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
             curr->has_data = false;
             lru->push2head(curr);
             lru->size += 1;
+            this->bus_of(addr)->add_sharer(this->id, addr);
 
             log(this->name(), "read data");
             this->send_probe_read(addr);
@@ -336,33 +431,32 @@ void Cache::lru_write(uint64_t addr, uint32_t cpuid, LRU* lru) {
 
 void Cache::send_probe_read(uint64_t addr) {
     request req = req_template(addr, op_type::probe_read, location::all);
-    this->send_buffer.push_back(req);
-
-    request_id rid;
-    rid.source = location::cache;
-    rid.cpu_id = this->id;
-
-    this->bus_port->try_request(rid);
+    this->send_to_bus(req);
 }
 
 void Cache::send_probe_write(uint64_t addr) {
     request req = req_template(addr, op_type::probe_write, location::all);
-    this->send_buffer.push_back(req);
-
-    request_id rid;
-    rid.source = location::cache;
-    rid.cpu_id = this->id;
-    this->bus_port->try_request(rid);
+    this->send_to_bus(req);
 }
 
 void Cache::send_write_memory(uint64_t addr) {
     request req = req_template(addr, op_type::probe_write, location::memory);
-    this->send_buffer.push_back(req);
+    this->send_to_bus(req);
+}
+
+void Cache::send_to_bus(const request &req) {
+    // Lines are interleaved over the buses, every bus snoops its own lines.
+    uint32_t bus_id = line_interleave(req.addr, this->num_buses);
+    RingBuffer<request> &buffer = this->send_buffers[bus_id];
+    if (buffer.full()) {
+        buffer.grow();
+    }
+    buffer.push(req);
 
     request_id rid;
     rid.source = location::cache;
     rid.cpu_id = this->id;
-    this->bus_port->try_request(rid);
+    this->bus_port[bus_id]->try_request(rid);
 }
 
 int Cache::put_ack_from(location l) {
@@ -4,21 +4,20 @@
 #include <iostream>
 #include <systemc.h>
 #include <stdexcept>
+#include <tlm.h>
+#include <tlm_utils/simple_target_socket.h>
 
+#include "Checkpoint.h"
 #include "Memory.h"
 #include "cache_if.h"
+#include "cache_size.h"
 #include "helpers.h"
 #include "types.h"
 #include "lru.h"
 
-#define S_CACHE_SIZE 32 << 10 // 32KBytes can be stored in the cache.
-
 using namespace std;
 using namespace sc_core; // This pollutes namespace, better: only import what you need.
 
-static const size_t CACHE_SIZE = S_CACHE_SIZE;
-static const size_t NR_SETS = CACHE_SIZE / (SET_SIZE * BLOCK_SIZE);
-
 typedef struct Set {
     LRU *lru;
 } Set;
@@ -28,62 +27,78 @@ typedef struct Set {
 // cache_if interface.
 class Cache : public cache_if, public sc_module {
 public:
-    sc_port<bus_if> bus_port;
-    sc_in<request> Port_Cache; // single producer multiple consumer (bus <-> many caches).
+    sc_port<bus_if, 0> bus_port; // one binding per bus, in bus id order.
     sc_in_clk clk;
+    // The loosely timed path from the processor.
+    tlm_utils::simple_target_socket<Cache> socket;
 
     // cpu_cache interface methods.
     int cpu_read(uint64_t addr) override;
 
     int cpu_write(uint64_t addr) override;
 
+    void touch(uint64_t addr) override;
+
     int put_ack_from(location) override;
 
     int ack() override;
 
-    std::vector<request> get_requests() override;
+    RingBuffer<request> &send_buffer(uint32_t bus_id) override {
+        return this->send_buffers[bus_id];
+    }
 
     // Constructor without SC_ macro.
-    Cache(sc_module_name name_, int id_) : sc_module(name_), id(id_) {
-        this->has_new_event = false;
+    Cache(sc_module_name name_, SimulationContext &context_, int id_, uint32_t num_buses_)
+            : sc_module(name_), socket("socket"), context(context_), id(id_), num_buses(num_buses_) {
+        this->socket.register_b_transport(this, &Cache::b_transport);
+        this->socket.register_get_direct_mem_ptr(this, &Cache::get_direct_mem_ptr);
+        this->send_buffers = std::vector<RingBuffer<request>>(num_buses);
         this->data_ok = false;
         this->ack_ok = false;
-        sensitive << clk.pos();
-        SC_THREAD(probe);
         this->sets = new Set[NR_SETS];
         for (uint8_t i = 0; i < NR_SETS; i++) {
             this->sets[i].lru = new LRU(SET_SIZE, i);
         }
     }
 
-    SC_HAS_PROCESS(Cache);
-
-    void probe();
-
     ~Cache() override {
         delete this->sets;
     }
 
-    int send_data(request req) override;
+    int send_data(const request &req) override;
+
+    // The sets for a checkpoint, taken when no access is in flight.
+    void save(checkpoint::processor &state) const;
+
+    // Replaces the sets with the ones of a checkpoint.
+    void restore(const checkpoint::processor &state);
 
-    int send_new_event() override;
+    // Loosely timed access of the processor, `delay` is its local time.
+    void b_transport(tlm::tlm_generic_payload &trans, sc_time &delay);
+
+    // Lines only this cache has are handed out for direct access.
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload &trans, tlm::tlm_dmi &dmi);
+
+    // Applies a transaction of another cache, in the bus process.
+    void snoop(const request &event) override;
 
     bool get_cacheline_status(uint64_t addr, cache_status* curr_status) override;
 
     bool has_data(uint64_t) override;
 
+    // Both waits end at the first positive edge after the bus set the flag,
+    // the cycles in between are slept through.
     void wait_ack() {
         auto start = sc_time_stamp().to_default_time_units();
-        while (true) {
+        wait();
+        // This state can be invalid.
+        while (!this->ack_ok) {
+            wait(this->ack_event);
             wait();
-            // This state can be invalid.
-            if (this->ack_ok) {
-                this->ack_ok = false;
-                stats_waitbus(this->id, sc_time_stamp().to_default_time_units() - start);
-                cout << "timestamp: " << sc_time_stamp().to_default_time_units() << " start: " << start << endl;
-                return;
-            }
         }
+        this->ack_ok = false;
+        this->context.stats_waitbus(this->id, sc_time_stamp().to_default_time_units() - start);
+        log(this->name(), "waited for the bus since", start);
     }
 
     request req_template(uint64_t addr, op_type op, location dest) const {
@@ -98,22 +113,25 @@ public:
     }
 
     void wait_data() {
-        while (true) {
+        wait();
+        while (!this->data_ok) {
+            wait(this->data_event);
             wait();
-            if (this->data_ok) {
-                this->data_ok = false;
-                return;
-            }
         }
+        this->data_ok = false;
     }
 
 private:
+    SimulationContext &context;
     int id;
+    uint32_t num_buses;
     Set *sets;
-    vector<request> send_buffer;
+    // Requests wait in the buffer of the bus that owns their cache line.
+    vector<RingBuffer<request>> send_buffers;
     bool ack_ok;
     bool data_ok;
-    bool has_new_event;
+    sc_event ack_event;
+    sc_event data_event;
     request data;
     location ack_from;
 
@@ -126,6 +144,16 @@ private:
     void send_probe_write(uint64_t addr);
 
     void send_write_memory(uint64_t addr);
+
+    void send_to_bus(const request &req);
+
+    // The bus that snoops the line of `addr`.
+    bus_if *bus_of(uint64_t addr) {
+        return this->bus_port[line_interleave(addr, this->num_buses)];
+    }
+
+    // Takes a line handed out for direct access back from the processor.
+    void release_direct(uint64_t addr, const LRUnit *line);
 };
 
 #endif
@@ -0,0 +1,156 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+#include "Checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// "PSAC", the format version, then little endian fields:
+//   cycle, processors, sets per cache, then per processor
+//   position, ended, the five counters, the sum and the number of the bus
+//   waits and every set as its line count followed by tag and status of
+//   each line.
+static const char MAGIC[4] = {'P', 'S', 'A', 'C'};
+static const uint32_t VERSION = 2;
+
+static void put(FILE *out, uint64_t value, size_t bytes) {
+    unsigned char buffer[8];
+    for (size_t i = 0; i < bytes; i++) {
+        buffer[i] = (unsigned char) (value >> (8 * i));
+    }
+    fwrite(buffer, 1, bytes, out);
+}
+
+static uint64_t get(FILE *in, size_t bytes, const char *file) {
+    unsigned char buffer[8];
+    if (fread(buffer, 1, bytes, in) != bytes) {
+        throw runtime_error(string("Error, unexpected end of checkpoint ") + file + "\n");
+    }
+    uint64_t value = 0;
+    for (size_t i = bytes; i > 0; i--) {
+        value = (value << 8) | buffer[i - 1];
+    }
+    return value;
+}
+
+void save_checkpoint(const char *file, const checkpoint &state) {
+    FILE *out = fopen(file, "wb");
+    if (out == nullptr) {
+        throw runtime_error(string("Error, unable to write checkpoint ") + file + "\n");
+    }
+    size_t num_sets = state.processors.empty() ? 0 : state.processors[0].sets.size();
+    fwrite(MAGIC, 1, sizeof(MAGIC), out);
+    put(out, VERSION, 4);
+    put(out, state.cycle, 8);
+    put(out, state.processors.size(), 4);
+    put(out, num_sets, 4);
+
+    for (const auto &p : state.processors) {
+        put(out, p.position, 8);
+        put(out, p.ended, 1);
+        put(out, (uint32_t) p.stats.writehit, 4);
+        put(out, (uint32_t) p.stats.writemiss, 4);
+        put(out, (uint32_t) p.stats.readhit, 4);
+        put(out, (uint32_t) p.stats.readmiss, 4);
+        put(out, (uint32_t) p.stats.memory_access, 4);
+        uint64_t bits;
+        memcpy(&bits, &p.stats.buswaitcycle, sizeof(bits));
+        put(out, bits, 8);
+        put(out, p.stats.buswaits, 8);
+        for (const auto &set : p.sets) {
+            put(out, set.size(), 1);
+            for (const auto &l : set) {
+                put(out, l.tag, 8);
+                put(out, l.status, 1);
+            }
+        }
+    }
+
+    bool failed = ferror(out) != 0;
+    if (fclose(out) != 0 || failed) {
+        throw runtime_error(string("Error, unable to write checkpoint ") + file + "\n");
+    }
+}
+
+checkpoint load_checkpoint(const char *file) {
+    FILE *in = fopen(file, "rb");
+    if (in == nullptr) {
+        throw runtime_error(string("Error, unable to open checkpoint ") + file + "\n");
+    }
+    checkpoint state;
+    try {
+        char magic[4];
+        if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, MAGIC, sizeof(magic)) != 0
+            || get(in, 4, file) != VERSION) {
+            throw runtime_error(string("Error, ") + file + " is no checkpoint of this simulator\n");
+        }
+        state.cycle = get(in, 8, file);
+        uint32_t processors = (uint32_t) get(in, 4, file);
+        uint32_t num_sets = (uint32_t) get(in, 4, file);
+
+        state.processors = vector<checkpoint::processor>(processors);
+        for (auto &p : state.processors) {
+            p.position = get(in, 8, file);
+            p.ended = get(in, 1, file) != 0;
+            p.stats.writehit = (int) get(in, 4, file);
+            p.stats.writemiss = (int) get(in, 4, file);
+            p.stats.readhit = (int) get(in, 4, file);
+            p.stats.readmiss = (int) get(in, 4, file);
+            p.stats.memory_access = (int) get(in, 4, file);
+            uint64_t bits = get(in, 8, file);
+            memcpy(&p.stats.buswaitcycle, &bits, sizeof(bits));
+            p.stats.buswaits = get(in, 8, file);
+            p.sets = vector<vector<checkpoint::line>>(num_sets);
+            for (auto &set : p.sets) {
+                size_t lines = get(in, 1, file);
+                if (lines > SET_SIZE) {
+                    throw runtime_error(string("Error, the sets in ") + file + " do not fit this cache\n");
+                }
+                set = vector<checkpoint::line>(lines);
+                for (auto &l : set) {
+                    l.tag = get(in, 8, file);
+                    l.status = (cache_status) get(in, 1, file);
+                }
+            }
+        }
+    } catch (...) {
+        fclose(in);
+        throw;
+    }
+    fclose(in);
+    return state;
+}
+
+vector<checkpoint::line> save_set(const LRU *lru) {
+    vector<checkpoint::line> lines;
+    for (const LRUnit *curr = lru->head; curr != nullptr; curr = curr->next) {
+        lines.push_back(checkpoint::line{curr->tag, curr->status});
+    }
+    return lines;
+}
+
+void restore_set(LRU *lru, const vector<checkpoint::line> &lines) {
+    for (uint8_t i = 0; i < lru->capacity; i++) {
+        lru->lines[i].next = nullptr;
+        lru->lines[i].prev = nullptr;
+        lru->lines[i].status = cache_status::invalid;
+        lru->lines[i].has_data = false;
+    }
+    lru->head = nullptr;
+    lru->tail = nullptr;
+    lru->size = 0;
+
+    // The least recently used line goes in first, every line is pushed to the head.
+    for (size_t i = lines.size(); i > 0; i--) {
+        LRUnit *curr = &lru->lines[lru->size];
+        curr->tag = lines[i - 1].tag;
+        curr->status = lines[i - 1].status;
+        curr->has_data = true;
+        lru->push2head(curr);
+        lru->size += 1;
+    }
+}
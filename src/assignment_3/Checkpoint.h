@@ -0,0 +1,57 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+
+#ifndef FRAMEWORK_CHECKPOINT_H
+#define FRAMEWORK_CHECKPOINT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "lru.h"
+#include "simulation.h"
+#include "types.h"
+
+/*
+ * The state of a simulation, written by --checkpoint and continued by
+ * --restore. A checkpoint is taken once the machine drained: from
+ * checkpoint_at on no processor reads its next trace entry, the accesses in
+ * flight finish and the checkpoint is the cycle the last processor stopped.
+ * Buses and memory are idle then, only posted writes may still wait in a
+ * write queue, they cost time but hold no state and are dropped.
+ * So a checkpoint is the caches, the trace positions and the statistic
+ * counters. It does not depend on the bus and memory options, a warm-up
+ * is reused with other ones, and the SystemC model and the fast engine
+ * read each other's checkpoints. Bus and memory statistics count from the
+ * restore.
+ */
+typedef struct checkpoint {
+    typedef struct line {
+        uint64_t tag;
+        cache_status status;
+    } line;
+
+    typedef struct processor {
+        uint64_t position; // trace entries read.
+        bool ended;        // its trace ended.
+        stats_snapshot stats;
+        std::vector<std::vector<line>> sets; // valid lines, most recently used first.
+    } processor;
+
+    uint64_t cycle; // the positive edge every processor reads its next entry at.
+    std::vector<processor> processors;
+} checkpoint;
+
+// Throws runtime_error if the file cannot be written or read, or it is no
+// checkpoint of this cache geometry.
+void save_checkpoint(const char *file, const checkpoint &state);
+
+checkpoint load_checkpoint(const char *file);
+
+// The lines of a set, for a checkpoint taken when no fill is in flight.
+std::vector<checkpoint::line> save_set(const LRU *lru);
+
+// Replaces the lines of a set.
+void restore_set(LRU *lru, const std::vector<checkpoint::line> &lines);
+
+#endif //FRAMEWORK_CHECKPOINT_H
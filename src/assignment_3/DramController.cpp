@@ -0,0 +1,159 @@
+//
+// Created by yanghoo on 3/12/24.
+//
+#include "DramController.h"
+#include <cstdio>
+
+using namespace std;
+
+DramController::DramController(const memory_config &config, const dram_timing &timing, page_policy policy,
+                               dram_scheduler scheduler)
+        : MemoryController(config), timing(timing), policy(policy), scheduler(scheduler) {
+    dram_channel empty;
+    empty.banks = vector<row_buffer>(config.num_banks, row_buffer{false, 0, 0, 0, 0, 0});
+    empty.next_refresh = timing.t_refi;
+    empty.has_data = false;
+    empty.last_write = false;
+    this->state = vector<dram_channel>(config.num_channels, empty);
+}
+
+void DramController::advance(uint32_t channel_id, uint64_t cycle) {
+    if (this->timing.t_refi == 0) {
+        return;
+    }
+    dram_channel &ch = this->state[channel_id];
+    // Refreshes that fell into an idle period are caught up here.
+    while (cycle >= ch.next_refresh) {
+        uint64_t start = ch.next_refresh;
+        for (auto &b : ch.banks) {
+            start = max(start, b.pre_ready);
+        }
+        for (auto &b : ch.banks) {
+            b.open = false;
+            b.act_ready = max(b.act_ready, start + this->timing.t_rp + this->timing.t_rfc);
+        }
+        ch.next_refresh += this->timing.t_refi;
+        this->refreshes += 1;
+    }
+}
+
+bool DramController::can_issue(uint32_t channel_id, uint32_t bank_id, uint64_t cycle) const {
+    return this->state[channel_id].banks[bank_id].col_ready <= cycle;
+}
+
+size_t DramController::pick(uint32_t channel_id, uint32_t bank_id, const std::deque<pending> &queue) {
+    row_buffer &buffer = this->state[channel_id].banks[bank_id];
+    if (this->scheduler == dram_scheduler::fcfs_order || !buffer.open || buffer.bypassed >= MAX_BYPASS) {
+        buffer.bypassed = 0;
+        return 0;
+    }
+
+    // Requests to one row keep their order, so two accesses of the same line
+    // never swap.
+    for (size_t i = 0; i < queue.size(); i++) {
+        if (this->row_of(queue[i].req.addr) == buffer.row) {
+            buffer.bypassed = i == 0 ? 0 : buffer.bypassed + 1;
+            return i;
+        }
+    }
+    buffer.bypassed = 0;
+    return 0;
+}
+
+bool DramController::row_wanted(const bank &b, uint64_t row) const {
+    for (const auto &p : b.queue) {
+        if (this->row_of(p.req.addr) == row) {
+            return true;
+        }
+    }
+    for (const auto &p : b.writes) {
+        if (this->row_of(p.req.addr) == row) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t DramController::issue(uint32_t channel_id, uint32_t bank_id, const pending &next, uint64_t cycle) {
+    dram_channel &ch = this->state[channel_id];
+    row_buffer &buffer = ch.banks[bank_id];
+    uint64_t row = this->row_of(next.req.addr);
+    bool write = next.req.op == op_type::probe_write;
+
+    uint64_t column;
+    if (buffer.open && buffer.row == row) {
+        this->row_hits += 1;
+        column = max(cycle, buffer.col_ready);
+    } else {
+        uint64_t activate;
+        if (buffer.open) {
+            this->row_conflicts += 1;
+            activate = max(max(cycle, buffer.pre_ready) + this->timing.t_rp, buffer.act_ready);
+        } else {
+            this->row_empty += 1;
+            activate = max(cycle, buffer.act_ready);
+        }
+        buffer.open = true;
+        buffer.row = row;
+        buffer.pre_ready = activate + this->timing.t_ras;
+        column = activate + this->timing.t_rcd;
+    }
+
+    // The data bus of the channel turns around between reads and writes.
+    channel &chan = this->channels[channel_id];
+    uint64_t data = column + this->timing.t_cas;
+    uint64_t bus_free = chan.data_busy_until;
+    if (ch.has_data && ch.last_write != write) {
+        bus_free += write ? this->timing.t_rtw : this->timing.t_wtr;
+        if (bus_free > max(data, chan.data_busy_until)) {
+            this->turnaround_cycles += bus_free - max(data, chan.data_busy_until);
+        }
+        this->turnarounds += 1;
+    }
+    data = max(data, bus_free);
+    uint64_t end = data + this->transfer_cycles;
+    chan.data_busy_until = end;
+    ch.has_data = true;
+    ch.last_write = write;
+
+    buffer.col_ready = column + this->transfer_cycles;
+    buffer.pre_ready = max(buffer.pre_ready, write ? end + this->timing.t_wr : buffer.col_ready);
+
+    bool close = this->policy == page_policy::closed_page
+                 || (this->policy == page_policy::adaptive_page && !this->row_wanted(chan.banks[bank_id], row));
+    if (close) {
+        buffer.open = false;
+        buffer.act_ready = max(buffer.act_ready, buffer.pre_ready + this->timing.t_rp);
+    }
+
+    if (write) {
+        this->writes += 1;
+        this->write_latency += end - next.arrival;
+    } else {
+        this->reads += 1;
+        this->read_latency += end - next.arrival;
+    }
+    return end;
+}
+
+void DramController::print_stats(std::ostream &os, uint64_t cycles) const {
+    static const char *policies[] = {"open", "closed", "adaptive"};
+    char line[256];
+
+    snprintf(line, sizeof(line), "Memory: DRAM, %u channel(s) x %u bank(s), %s interleaved, %s page, %s",
+             this->config.num_channels, this->config.num_banks, this->mapping_name(), policies[this->policy],
+             this->scheduler == dram_scheduler::fcfs_order ? "fcfs" : "fr-fcfs");
+    os << line << endl;
+    this->print_channels(os, cycles);
+
+    uint64_t accesses = this->row_hits + this->row_empty + this->row_conflicts;
+    os << "RowHits\tRowEmpty\tRowConfl\tHitRate\t\tAvgReadLat\tAvgWriteLat\tTurnarounds\tTurnCycles\tRefreshes"
+       << endl;
+    snprintf(line, sizeof(line), "%lu\t%lu\t\t%lu\t\t%f\t%f\t%f\t%lu\t\t%lu\t\t%lu", (unsigned long) this->row_hits,
+             (unsigned long) this->row_empty, (unsigned long) this->row_conflicts,
+             accesses ? (double) this->row_hits / accesses : 0,
+             this->reads ? (double) this->read_latency / this->reads : 0,
+             this->writes ? (double) this->write_latency / this->writes : 0, (unsigned long) this->turnarounds,
+             (unsigned long) this->turnaround_cycles, (unsigned long) this->refreshes);
+    os << line << endl;
+}
@@ -0,0 +1,77 @@
+//
+// Created by yanghoo on 3/12/24.
+//
+
+#ifndef FRAMEWORK_DRAM_CONTROLLER_H
+#define FRAMEWORK_DRAM_CONTROLLER_H
+
+#include "MemoryController.h"
+
+/*
+ * DRAM banks with a row buffer. An access to the open row only needs a
+ * column command, an access to a closed bank activates the row first and
+ * one to another row precharges the bank before that. Data of a channel
+ * shares one bus, switching between reads and writes costs a turnaround.
+ * Every t_refi cycles all banks of a channel are precharged and refreshed.
+ */
+class DramController : public MemoryController {
+public:
+    DramController(const memory_config &config, const dram_timing &timing, page_policy policy,
+                   dram_scheduler scheduler);
+
+    void print_stats(std::ostream &os, uint64_t cycles) const override;
+
+protected:
+    void advance(uint32_t channel_id, uint64_t cycle) override;
+
+    bool can_issue(uint32_t channel_id, uint32_t bank_id, uint64_t cycle) const override;
+
+    size_t pick(uint32_t channel_id, uint32_t bank_id, const std::deque<pending> &queue) override;
+
+    uint64_t issue(uint32_t channel_id, uint32_t bank_id, const pending &next, uint64_t cycle) override;
+
+private:
+    // Row hits that may overtake the oldest request of a bank in a row.
+    static const uint32_t MAX_BYPASS = 16;
+
+    typedef struct row_buffer {
+        bool open;
+        uint64_t row;
+        uint64_t act_ready; // earliest activate.
+        uint64_t col_ready; // earliest column command.
+        uint64_t pre_ready; // earliest precharge.
+        uint32_t bypassed;  // row hits served before the oldest request.
+    } row_buffer;
+
+    typedef struct dram_channel {
+        std::vector<row_buffer> banks;
+        uint64_t next_refresh;
+        bool has_data; // the data bus carried something already.
+        bool last_write;
+    } dram_channel;
+
+    dram_timing timing;
+    page_policy policy;
+    dram_scheduler scheduler;
+    std::vector<dram_channel> state;
+
+    uint64_t row_hits = 0;
+    uint64_t row_empty = 0;
+    uint64_t row_conflicts = 0;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t read_latency = 0;
+    uint64_t write_latency = 0;
+    uint64_t turnarounds = 0;
+    uint64_t turnaround_cycles = 0; // data bus cycles lost to turnarounds.
+    uint64_t refreshes = 0;
+
+    uint64_t row_of(uint64_t addr) const {
+        return addr / ((uint64_t) ROW_SIZE * this->config.num_channels * this->config.num_banks);
+    }
+
+    // Whether a request in the bank queue still wants `row`.
+    bool row_wanted(const bank &b, uint64_t row) const;
+};
+
+#endif //FRAMEWORK_DRAM_CONTROLLER_H
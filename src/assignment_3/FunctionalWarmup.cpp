@@ -0,0 +1,205 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+#include "FunctionalWarmup.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Rows of the trace read at once, a row is one entry of every processor.
+static const size_t ROWS_PER_READ = 4096;
+
+FunctionalWarmup::FunctionalWarmup(uint32_t num_cpus, size_t num_sets)
+        : num_cpus(num_cpus), num_sets(num_sets), snoop_filter(num_cpus) {
+    this->tags = vector<uint64_t>(num_cpus * num_sets * SET_SIZE, 0);
+    this->used = vector<uint64_t>(num_cpus * num_sets * SET_SIZE, 0);
+    this->states = vector<cache_status>(num_cpus * num_sets * SET_SIZE, cache_status::invalid);
+    this->positions = vector<uint64_t>(num_cpus, 0);
+    this->ended = vector<bool>(num_cpus, false);
+}
+
+uint64_t FunctionalWarmup::entries_of(const sim_config &config, const char *tracefile, uint32_t num_cpus) {
+    if (config.warmup_percent == 0) {
+        return config.warmup_entries;
+    }
+    // The header is the signature and the number of processors, 4 bytes each.
+    FILE *file = fopen(tracefile, "rb");
+    if (file == nullptr || fseek(file, 0, SEEK_END) != 0) {
+        throw runtime_error(string("Unable to open file: ") + tracefile);
+    }
+    long size = ftell(file);
+    fclose(file);
+    uint64_t rows = size > 8 ? (uint64_t) (size - 8) / 8 / num_cpus : 0;
+    return rows * config.warmup_percent / 100;
+}
+
+checkpoint FunctionalWarmup::warm_up(const sim_config &config, const char *tracefile, uint32_t num_cpus,
+                                     size_t num_sets) {
+    FunctionalWarmup warmup(num_cpus, num_sets);
+    uint64_t entries = entries_of(config, tracefile, num_cpus);
+    auto start = chrono::steady_clock::now();
+    warmup.run(tracefile, entries);
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    // Every read or write of the warm-up is one use. The time per entry
+    // leaves out reading the file.
+    uint64_t read = warmup.uses;
+    char line[256];
+    snprintf(line, sizeof(line), "Warm-up: %lu entries per processor, %.1f ms, %.1f ns per entry",
+             (unsigned long) entries, ns / 1e6, read ? warmup.access_ns / (double) read : 0);
+    cerr << line << endl;
+    return warmup.state();
+}
+
+void FunctionalWarmup::run(const char *tracefile, uint64_t entries) {
+    FILE *file = fopen(tracefile, "rb");
+    if (file == nullptr || fseek(file, 8, SEEK_SET) != 0) {
+        throw runtime_error(string("Unable to open file: ") + tracefile);
+    }
+
+    size_t row_size = this->num_cpus * 8;
+    vector<unsigned char> buffer((size_t) min<uint64_t>(ROWS_PER_READ, entries) * row_size);
+    uint32_t running = this->num_cpus;
+    for (uint64_t row = 0; row < entries && running > 0;) {
+        size_t rows = (size_t) min<uint64_t>(ROWS_PER_READ, entries - row);
+        // A partial entry at the end is not read, like in TraceFile.
+        size_t read = fread(buffer.data(), 1, rows * row_size, file) / 8;
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < rows * this->num_cpus; i++) {
+            uint32_t id = (uint32_t) (i % this->num_cpus);
+            if (this->ended[id]) continue;
+            if (i >= read) {
+                // No end tag, the trace stops with the file.
+                this->ended[id] = true;
+                running -= 1;
+                continue;
+            }
+            TraceFile::Entry entry = TraceFile::decode(&buffer[i * 8]);
+            this->positions[id] += 1;
+            switch (entry.type) {
+                case TraceFile::ENTRY_TYPE_READ:
+                    this->access(id, false, entry.addr);
+                    break;
+                case TraceFile::ENTRY_TYPE_WRITE:
+                    this->access(id, true, entry.addr);
+                    break;
+                case TraceFile::ENTRY_TYPE_END:
+                    this->ended[id] = true;
+                    running -= 1;
+                    break;
+                default:
+                    break;
+            }
+        }
+        this->access_ns += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        row += rows;
+    }
+    fclose(file);
+    // An ended processor is at position 0, like TraceFile::position says.
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        if (this->ended[id]) {
+            this->positions[id] = 0;
+        }
+    }
+}
+
+size_t FunctionalWarmup::find(uint32_t id, uint64_t addr) const {
+    size_t set = this->set_of(id, addr);
+    uint64_t tag = (addr >> 5) / this->num_sets + 1;
+    for (size_t i = set; i < set + SET_SIZE; i++) {
+        if (this->tags[i] == tag) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+bool FunctionalWarmup::snoop(uint32_t id, uint64_t addr, bool invalidate) {
+    bool shared = false;
+    this->snoop_filter.sharers(addr, this->snoop_targets);
+    for (uint32_t other : this->snoop_targets) {
+        if (other == id) continue;
+        size_t line = this->find(other, addr);
+        if (line == SIZE_MAX) continue;
+
+        shared = true;
+        this->states[line] = snooped(this->states[line], invalidate);
+        if (invalidate) {
+            this->tags[line] = 0;
+        }
+    }
+    if (invalidate) {
+        this->snoop_filter.invalidate_others(id, addr);
+    }
+    return shared;
+}
+
+void FunctionalWarmup::access(uint32_t id, bool write, uint64_t addr) {
+    size_t line = this->find(id, addr);
+    if (line == SIZE_MAX) {
+        // The free way first, otherwise the least recently used one. Its
+        // write back only costs time.
+        size_t set = this->set_of(id, addr);
+        line = set;
+        for (size_t i = set; i < set + SET_SIZE; i++) {
+            if (this->tags[i] == 0) {
+                line = i;
+                break;
+            }
+            if (this->used[i] < this->used[line]) {
+                line = i;
+            }
+        }
+        if (this->tags[line] != 0) {
+            uint64_t victim = ((this->tags[line] - 1) * this->num_sets + (addr >> 5) % this->num_sets) << 5;
+            this->snoop_filter.remove(id, victim);
+        }
+        this->tags[line] = (addr >> 5) / this->num_sets + 1;
+        this->snoop_filter.add(id, addr);
+        this->states[line] = this->snoop(id, addr, false) ? cache_status::shared : cache_status::exclusive;
+    }
+    this->used[line] = ++this->uses;
+
+    cache_status &status = this->states[line];
+    if (write) {
+        // No other cache has an exclusive or modified line.
+        if (status != cache_status::exclusive && status != cache_status::modified) {
+            this->snoop(id, addr, true);
+        }
+        status = cache_status::modified;
+    }
+}
+
+checkpoint FunctionalWarmup::state() const {
+    checkpoint state;
+    state.cycle = 0;
+    state.processors = vector<checkpoint::processor>(this->num_cpus);
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        checkpoint::processor &p = state.processors[id];
+        p.position = this->positions[id];
+        p.ended = this->ended[id];
+        p.stats = stats_snapshot{0, 0, 0, 0, 0, 0, 0};
+        p.sets = vector<vector<checkpoint::line>>(this->num_sets);
+        for (size_t s = 0; s < this->num_sets; s++) {
+            size_t set = (id * this->num_sets + s) * SET_SIZE;
+            vector<size_t> valid;
+            for (size_t i = set; i < set + SET_SIZE; i++) {
+                if (this->tags[i] != 0) {
+                    valid.push_back(i);
+                }
+            }
+            // Most recently used first.
+            sort(valid.begin(), valid.end(), [this](size_t a, size_t b) { return this->used[a] > this->used[b]; });
+            for (size_t i : valid) {
+                p.sets[s].push_back(checkpoint::line{this->tags[i] - 1, this->states[i]});
+            }
+        }
+    }
+    return state;
+}
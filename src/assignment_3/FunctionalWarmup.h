@@ -0,0 +1,75 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+
+#ifndef FRAMEWORK_FUNCTIONAL_WARMUP_H
+#define FRAMEWORK_FUNCTIONAL_WARMUP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "SnoopFilter.h"
+#include "config.h"
+#include "simulation.h"
+#include "types.h"
+
+/*
+ * Functional fast-forward through the start of the trace. Only tags,
+ * recency and MOESI states change: an access takes no time, there is no
+ * bus or memory, and the coherence transitions a transaction causes in the
+ * other caches happen at once. Processors take turns per entry, in the
+ * order of the file, read in chunks of rows up to the last row it needs
+ * instead of with one seek per entry like TraceFile.
+ * The result is a checkpoint of cycle 0 with warm caches and zero
+ * statistics, the detailed model continues from it like from --restore.
+ */
+class FunctionalWarmup {
+public:
+    FunctionalWarmup(uint32_t num_cpus, size_t num_sets);
+
+    // Runs the first `entries` entries of every processor, fewer where a
+    // trace ends before.
+    void run(const char *tracefile, uint64_t entries);
+
+    checkpoint state() const;
+
+    // The warm-up --warmup asks for, reported on cerr, for `num_cpus`
+    // caches of `num_sets` sets.
+    static checkpoint warm_up(const sim_config &config, const char *tracefile, uint32_t num_cpus, size_t num_sets);
+
+private:
+    uint32_t num_cpus;
+    size_t num_sets;
+    // num_sets * SET_SIZE ways per processor. The tags of a set share a
+    // host cache line, a snoop reads one per cache.
+    std::vector<uint64_t> tags; // tag + 1, 0 for a free way.
+    std::vector<uint64_t> used; // the ways of a set in recency order.
+    std::vector<cache_status> states;
+    std::vector<uint64_t> positions;
+    std::vector<bool> ended;
+    uint64_t uses = 0;
+    double access_ns = 0; // host time of the accesses, without the reads.
+    // The caches a snoop visits.
+    SnoopFilter snoop_filter;
+    std::vector<uint32_t> snoop_targets;
+
+    // The first way of the set of `addr`.
+    size_t set_of(uint32_t id, uint64_t addr) const {
+        return (id * this->num_sets + (addr >> 5) % this->num_sets) * SET_SIZE;
+    }
+
+    // The entries per processor of --warmup.
+    static uint64_t entries_of(const sim_config &config, const char *tracefile, uint32_t num_cpus);
+
+    // The way that holds `addr`, SIZE_MAX if none.
+    size_t find(uint32_t id, uint64_t addr) const;
+
+    void access(uint32_t id, bool write, uint64_t addr);
+
+    // The snoop of a read or an invalidation in the other caches, returns
+    // whether one of them had the line.
+    bool snoop(uint32_t id, uint64_t addr, bool invalidate);
+};
+
+#endif //FRAMEWORK_FUNCTIONAL_WARMUP_H
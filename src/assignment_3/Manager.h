@@ -16,11 +16,15 @@ class Manager : public Manager_if, public sc_module {
     sc_in_clk clock;
     sc_out<bool> start;
 
-    Manager(sc_module_name name_) : sc_module(name_) {
+    // `checkpoint_at` is the cycle the processors stop at, 0 for none.
+    Manager(sc_module_name name_, const SimulationContext &context_, uint64_t checkpoint_at_)
+            : sc_module(name_), context(context_), checkpoint_at(checkpoint_at_) {
         SC_THREAD(execute);
         sensitive << clock.pos();
         log(name(), "constructed with dispatcher");
         this->finished = 0;
+        this->parked = 0;
+        this->drained_cycle = 0;
         dont_initialize(); // don't call execute to initialise it.
     }
 
@@ -28,18 +32,52 @@ class Manager : public Manager_if, public sc_module {
 
     int finish() override {
         this->finished += 1;
+        if ((uint32_t) (this->finished + this->parked) == this->context.num_cpus) {
+            this->all_finished.notify(SC_ZERO_TIME);
+        }
         return 0;
     }
 
+    bool checkpoint_due(uint64_t cycle) const override {
+        return this->checkpoint_at != 0 && cycle >= this->checkpoint_at;
+    }
+
+    int park() override {
+        this->parked += 1;
+        this->drained_cycle = (uint64_t) sc_time_stamp().to_default_time_units();
+        if ((uint32_t) (this->finished + this->parked) == this->context.num_cpus) {
+            this->all_finished.notify(SC_ZERO_TIME);
+        }
+        return 0;
+    }
+
+    // Every processor stopped for the checkpoint, none reached the end of
+    // the trace first.
+    bool drained() const {
+        return (uint32_t) this->parked == this->context.num_cpus;
+    }
+
+    // The cycle the last processor stopped at.
+    uint64_t drained_at() const {
+        return this->drained_cycle;
+    }
+
     private:
+    const SimulationContext &context;
+    uint64_t checkpoint_at;
     int finished;
+    int parked;
+    uint64_t drained_cycle;
+    sc_event all_finished;
 
     void execute() {
-        while (true) {
-            // Get the next action for the processor in the trace
-            this->start->write(true);
+        // Get the next action for the processor in the trace
+        this->start->write(true);
+        wait();
 
-            if ((uint32_t) this->finished == num_cpus) break;
+        // Stops at the first positive edge after the last processor finished.
+        while ((uint32_t) (this->finished + this->parked) != this->context.num_cpus) {
+            wait(this->all_finished);
             wait();
         }
         sc_stop();
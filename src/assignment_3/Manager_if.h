@@ -10,6 +10,13 @@
 class Manager_if : public virtual sc_interface {
 public:
     virtual int finish() = 0;
+
+    // Whether a processor stops for the checkpoint instead of reading its
+    // entry at `cycle`.
+    virtual bool checkpoint_due(uint64_t cycle) const = 0;
+
+    // A processor stopped for the checkpoint, the simulation stops once all did.
+    virtual int park() = 0;
 };
 
 #endif //FRAMEWORK_MANAGER_IF_H
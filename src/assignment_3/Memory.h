@@ -1,24 +1,33 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <algorithm>
 #include <iostream>
+#include <queue>
 #include <systemc.h>
+#include <unordered_map>
 
 #include "Memory_if.h"
+#include "MemoryController.h"
 #include "bus_if.h"
+#include "config.h"
 #include "helpers.h"
 #include "psa.h"
 
 class Memory : public Memory_if, public sc_module {
     public:
-    sc_port<bus_if> bus;
+    sc_port<bus_if, 0> bus; // one binding per bus, in bus id order.
     sc_in_clk clk;
 
-    Memory(sc_module_name name_) : sc_module(name_) {
-        SC_THREAD(send);
-        sensitive << clk.pos();
-        SC_THREAD(execute);
-        SC_THREAD(dispatch);
+    // One port per bus, the memory cycles go to the statistics of `context`.
+    Memory(sc_module_name name_, SimulationContext &context_, const sim_config &config)
+            : sc_module(name_), context(context_), num_ports(config.num_buses) {
+        this->ports = vector<port>(num_ports);
+        this->merge_reads = config.merge_reads;
+
+        this->controller = MemoryController::create(config);
+
+        SC_METHOD(execute);
         sensitive << clk.pos();
         dont_initialize();
     }
@@ -26,99 +35,323 @@ class Memory : public Memory_if, public sc_module {
     SC_HAS_PROCESS(Memory); // Needed because we didn't use SC_TOR
 
     ~Memory() override {
-        // nothing to do here right now.
+        delete this->controller;
     }
 
-    int read(request req) override {
-        this->requests.push_back(req);
+    int read(const request &req) override {
+        if (this->merge_reads && this->join_pending_read(req)) {
+            return 0;
+        }
+        push(this->ports[this->port_of(req)].requests, req);
+        this->wake.notify(SC_ZERO_TIME);
+        return 0;
+    }
+
+    int write(const request &req) override {
+        if (this->merge_reads) {
+            // Reads after the write must see its data, they cannot join.
+            auto range = this->pending_reads.equal_range(req.addr / BLOCK_SIZE);
+            for (auto it = range.first; it != range.second; it++) {
+                it->second.open = false;
+            }
+        }
+        push(this->ports[this->port_of(req)].requests, req);
+        this->wake.notify(SC_ZERO_TIME);
         return 0;
     }
 
-    int write(request req) override {
-        this->requests.push_back(req);
+    int speculative_read(const request &req) override {
+        this->speculative.push_back(req);
+        this->speculative_reads += 1;
+        push(this->ports[this->port_of(req)].requests, req);
+        this->wake.notify(SC_ZERO_TIME);
         return 0;
     }
 
-    void ack() override {
-        this->ack_ok = true;
+    void cancel(const request &req) override {
+        port &port = this->ports[this->port_of(req)];
+        auto spec = std::find(this->speculative.begin(), this->speculative.end(), req);
+        if (spec == this->speculative.end()) {
+            // The response left already, it waits for the bus or the bus
+            // dropped it.
+            for (size_t i = 0; i < port.send_buffer.size(); i++) {
+                if (answers(port.send_buffer[i], req)) {
+                    port.send_buffer.erase(i);
+                    break;
+                }
+            }
+            this->wasted_reads += 1;
+            return;
+        }
+        this->speculative.erase(spec);
+
+        size_t queued = 0;
+        while (queued < port.requests.size() && !(port.requests[queued] == req)) {
+            queued++;
+        }
+        if (queued < port.requests.size()) {
+            port.requests.erase(queued);
+            this->cancelled_reads += 1;
+        } else if (this->controller->cancel(req)) {
+            this->cancelled_reads += 1;
+        } else {
+            // The bank read the line, its response is dropped when ready.
+            this->dropped.push_back(req);
+            this->wasted_reads += 1;
+        }
+    }
+
+    void ack(uint32_t bus_id) override {
+        this->ports[bus_id].ack_ok = true;
+        this->wake.notify(SC_ZERO_TIME);
     }
 
-    vector<request> get_requests() override {
-        // copy the result.
-        vector<request> result = this->send_buffer;
-        this->send_buffer.clear();
-        return result;
+    RingBuffer<request> &send_buffer(uint32_t bus_id) override {
+        return this->ports[bus_id].send_buffer;
     }
 
+    // A method process that runs at the positive edges that have work, it
+    // sleeps through the cycles in which every request is in flight.
     void execute() {
-        while (true) {
-            wait(clk.negedge_event());
-            for (auto & task : this->pipeline) {
-                task.cycles += 1;
-            }
+        if (this->woken) {
+            // Woken half a cycle early, the positive edge is next.
+            this->woken = false;
+            next_trigger();
+            return;
         }
+        uint64_t cycle = current_cycle();
+        for (uint32_t port_id = 0; port_id < this->num_ports; port_id++) {
+            this->send_response(port_id);
+        }
+        this->dispatch(cycle);
+        this->schedule(cycle);
     }
 
-    void send() {
-        while (true) {
-            if ((!this->pipeline.empty()) && this->pipeline.front().cycles >= 100) {
-                auto response = this->pipeline.front().req;
-                this->pipeline.erase(this->pipeline.begin());
-                this->send_buffer.push_back(response);
+    void print_stats() const {
+        this->controller->print_stats(cout, current_cycle());
+        if (this->merge_reads) {
+            printf("Pending reads: %lu merged into %lu multicast response(s), at most %lu waiter(s)\n",
+                   (unsigned long) this->merged_reads, (unsigned long) this->multicasts,
+                   (unsigned long) this->max_waiters);
+        }
+        if (this->speculative_reads > 0) {
+            printf("Speculative reads: %lu, %lu cancelled before their bank, %lu wasted (%lu bytes)\n",
+                   (unsigned long) this->speculative_reads, (unsigned long) this->cancelled_reads,
+                   (unsigned long) this->wasted_reads, (unsigned long) this->wasted_reads * BLOCK_SIZE);
+        }
+    }
 
-                request_id response_id;
-                response_id.source = location::memory;
-                this->bus->try_request(response_id);
+private:
+    SimulationContext &context;
+
+    typedef struct task {
+        request req;
+        uint64_t ready; // cycle the response can be sent.
+        uint64_t seq;   // responses ready in the same cycle go in start order.
+    } task;
 
-                log(this->name(), "Memory sends data back to", to_string(response.receiver_id));
-                this->wait_ack();
-            } else {
-                wait();
+    typedef struct later {
+        bool operator()(const task &a, const task &b) const {
+            return a.ready != b.ready ? a.ready > b.ready : a.seq > b.seq;
+        }
+    } later;
+
+    // A read in flight that later reads of the same line join, its response
+    // goes to all of them in one bus transaction.
+    typedef struct pending_read {
+        uint16_t primary; // the cache whose read went to the controller.
+        bool open;       // closed by a write to the line.
+        vector<request> waiters;
+    } pending_read;
+
+    MemoryController *controller;
+    vector<MemoryController::access> started;
+    bool merge_reads;
+    // Keyed by line, a line has several entries when a write closed one.
+    std::unordered_multimap<uint64_t, pending_read> pending_reads;
+    uint64_t merged_reads = 0;
+    uint64_t multicasts = 0;
+    size_t max_waiters = 0;
+    // Speculative reads whose response was not sent yet, and the ones of
+    // them that were cancelled after their bank started.
+    vector<request> speculative;
+    vector<request> dropped;
+    uint64_t speculative_reads = 0;
+    uint64_t cancelled_reads = 0;
+    uint64_t wasted_reads = 0;
+    uint64_t next_seq = 0;
+    // Notified by new requests and acks, and timed for the earliest response.
+    sc_event wake;
+    bool woken = false; // triggered by `wake`, not by the clock.
+
+    // Every bus has its own request queue and response buffer, a port only
+    // sends its next response after the bus acked the previous one.
+    typedef struct port {
+        RingBuffer<request> requests;
+        RingBuffer<request> send_buffer;
+        // In flight responses, the earliest on top.
+        std::priority_queue<task, vector<task>, later> pipeline;
+        bool ack_ok = false;
+        bool waiting_ack = false;
+    } port;
+    uint32_t num_ports;
+    vector<port> ports;
+
+    uint32_t port_of(const request &req) const {
+        return line_interleave(req.addr, this->num_ports);
+    }
+
+    static uint64_t current_cycle() {
+        return (uint64_t) sc_time_stamp().to_default_time_units();
+    }
+
+    // A full buffer grows, a request or response is never dropped.
+    static void push(RingBuffer<request> &buffer, const request &req) {
+        if (buffer.full()) {
+            buffer.grow();
+        }
+        buffer.push(req);
+    }
+
+    static bool answers(const request &response, const request &read) {
+        return response.receiver_id == read.sender_id && response.addr == read.addr;
+    }
+
+    // Whether `response` belongs to a cancelled read, it is not sent then.
+    bool cancelled(const request &response) {
+        if (this->speculative.empty() && this->dropped.empty()) {
+            return false;
+        }
+        auto by_response = [&response](const request &read) { return answers(response, read); };
+        auto spec = std::find_if(this->speculative.begin(), this->speculative.end(), by_response);
+        if (spec != this->speculative.end()) {
+            this->speculative.erase(spec);
+        }
+        auto drop = std::find_if(this->dropped.begin(), this->dropped.end(), by_response);
+        if (drop == this->dropped.end()) {
+            return false;
+        }
+        this->dropped.erase(drop);
+        return true;
+    }
+
+    bool join_pending_read(const request &req) {
+        uint64_t line = req.addr / BLOCK_SIZE;
+        auto range = this->pending_reads.equal_range(line);
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second.open) {
+                it->second.waiters.push_back(req);
+                this->max_waiters = max(this->max_waiters, it->second.waiters.size());
+                this->merged_reads += 1;
+                this->context.stats_memory_access(req.sender_id, 1);
+                return true;
             }
         }
+        this->pending_reads.emplace(line, pending_read{req.sender_id, true, vector<request>()});
+        return false;
     }
 
-    void dispatch() {
-        while (true) {
-            if (!this->requests.empty()) {
-                auto req = this->requests.front();
-                this->requests.erase(this->requests.begin());
+    // Responses of the reads that joined the one answered by `response`.
+    void add_waiters(port &port, const request &response) {
+        auto range = this->pending_reads.equal_range(response.addr / BLOCK_SIZE);
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second.primary != response.receiver_id) continue;
+
+            for (auto & waiter : it->second.waiters) {
+                request copy = response;
+                copy.receiver_id = waiter.sender_id;
+                push(port.send_buffer, copy);
+            }
+            this->multicasts += it->second.waiters.empty() ? 0 : 1;
+            this->pending_reads.erase(it);
+            return;
+        }
+    }
 
-                if (req.source != location::memory) {
-                    stats_memory_access(req.sender_id, 1);
-                    request response;
-                    response.addr = req.addr;
-                    response.source = location::memory;
-                    response.destination = location::cache;
-                    response.receiver_id = req.sender_id;
-                    response.op = op_type::data_transfer;
+    void dispatch(uint64_t cycle) {
+        // Every port accepts one request per cycle, it waits in the queue
+        // of its bank.
+        for (auto & port : this->ports) {
+            if (port.requests.empty()) continue;
 
-                    this->pipeline.push_back(task{.req =  response, .cycles =  0, .start_time = sc_time_stamp()});
-                }
+            auto req = port.requests.front();
+            if (req.source != location::memory) {
+                // A full write queue holds the port.
+                if (!this->controller->enqueue(req, cycle)) continue;
+                this->context.stats_memory_access(req.sender_id, 1);
             }
-            wait();
+            port.requests.pop();
+        }
+
+        this->started.clear();
+        this->controller->step(cycle, this->started);
+        for (auto & access : this->started) {
+            request response;
+            response.addr = access.req.addr;
+            response.source = location::memory;
+            response.destination = location::cache;
+            response.receiver_id = access.req.sender_id;
+            response.op = op_type::data_transfer;
+
+            this->ports[this->port_of(access.req)].pipeline.push(
+                    task{.req =  response, .ready = access.ready, .seq = this->next_seq++});
         }
     }
 
-private:
-    vector<request> requests = vector<request>();
-    vector<request> send_buffer = vector<request>();
-    typedef struct task {
-        request req;
-        int cycles;
-        sc_time start_time;
-    } task;
-    vector<task> pipeline = vector<task>();
+    // Triggers the next positive edge that has work: the next one while
+    // requests wait for a bank, otherwise the one of the earliest response
+    // that can be sent, or the one after a new request or ack.
+    void schedule(uint64_t cycle) {
+        bool queued = !this->controller->idle();
+        uint64_t next = UINT64_MAX;
+        for (auto & port : this->ports) {
+            queued = queued || !port.requests.empty();
+            if (!port.pipeline.empty() && !port.waiting_ack) {
+                next = min(next, port.pipeline.top().ready);
+            }
+        }
 
-    bool ack_ok = false;
-    void wait_ack() {
-        while (true) {
-            wait();
+        // The static sensitivity keeps the memory in its place among the
+        // processes of the positive edge.
+        if (queued || next <= cycle + 1) {
+            next_trigger();
+            return;
+        }
+        if (next != UINT64_MAX) {
+            // Half a cycle early, the positive edge after it is the one of `next`.
+            this->wake.notify(cycles(next - cycle) - cycles(1) / 2);
+        }
+        this->woken = true;
+        next_trigger(this->wake);
+    }
+
+    void send_response(uint32_t port_id) {
+        port &port = this->ports[port_id];
+        if (port.waiting_ack) {
             // This state can be invalid.
-            if (this->ack_ok) {
-                this->ack_ok = false;
-                return;
+            if (!port.ack_ok) return;
+            port.ack_ok = false;
+            port.waiting_ack = false;
+        }
+
+        // Banks finish out of order, the earliest ready response goes first.
+        while (!port.pipeline.empty() && port.pipeline.top().ready <= current_cycle()) {
+            auto response = port.pipeline.top().req;
+            port.pipeline.pop();
+            if (this->cancelled(response)) continue;
+
+            push(port.send_buffer, response);
+            if (this->merge_reads) {
+                this->add_waiters(port, response);
             }
+
+            request_id response_id;
+            response_id.source = location::memory;
+            this->bus[port_id]->try_request(response_id);
+
+            log(this->name(), "Memory sends data back to", (unsigned) response.receiver_id);
+            port.waiting_ack = true;
+            return;
         }
     }
 };
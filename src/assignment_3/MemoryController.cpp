@@ -0,0 +1,279 @@
+//
+// Created by yanghoo on 3/11/24.
+//
+#include "MemoryController.h"
+#include "DramController.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+MemoryController::MemoryController(const memory_config &config) : config(config) {
+    this->transfer_cycles = (BLOCK_SIZE + config.channel_width - 1) / config.channel_width;
+
+    channel empty;
+    empty.banks = vector<bank>(config.num_banks, bank{deque<pending>(), deque<pending>(), 0, 0, 0, 0});
+    empty.data_busy_until = 0;
+    empty.lines = 0;
+    empty.reads = 0;
+    empty.read_latency = 0;
+    empty.writes_queued = 0;
+    empty.draining = false;
+    this->channels = vector<channel>(config.num_channels, empty);
+}
+
+MemoryController *MemoryController::create(const sim_config &config) {
+    memory_config memory;
+    memory.num_channels = config.mem_channels;
+    memory.num_banks = config.mem_banks;
+    memory.bank_busy = config.bank_busy;
+    memory.channel_width = config.channel_width;
+    memory.mapping = config.mem_mapping;
+    memory.write_queue = config.write_queue;
+    memory.write_high = config.write_high;
+    memory.write_low = config.write_low;
+
+    if (config.dram) {
+        return new DramController(memory, config.dram_timing, config.page_policy, config.dram_scheduler);
+    }
+    return new MemoryController(memory);
+}
+
+void MemoryController::locate(uint64_t addr, uint32_t *channel_id, uint32_t *bank_id) const {
+    uint64_t channels = this->config.num_channels, banks = this->config.num_banks;
+
+    if (this->config.mapping == memory_mapping::line_mapping) {
+        // Consecutive lines go to consecutive channels, then banks.
+        uint64_t line = addr / BLOCK_SIZE;
+        *channel_id = (uint32_t) (line % channels);
+        *bank_id = (uint32_t) ((line / channels) % banks);
+        return;
+    }
+
+    // A whole row stays in one bank.
+    uint64_t row = addr / ROW_SIZE;
+    uint64_t channel = row % channels, bank = (row / channels) % banks;
+    if (this->config.mapping == memory_mapping::xor_mapping) {
+        // Permute with the upper row bits, so rows that are a multiple of
+        // channels * banks apart stop landing on the same bank.
+        uint64_t upper = row / (channels * banks);
+        bank = (bank ^ upper) & (banks - 1);
+        channel = (channel ^ (upper / banks)) & (channels - 1);
+    }
+    *channel_id = (uint32_t) channel;
+    *bank_id = (uint32_t) bank;
+}
+
+bool MemoryController::enqueue(const request &req, uint64_t cycle) {
+    uint32_t channel_id, bank_id;
+    this->locate(req.addr, &channel_id, &bank_id);
+
+    channel &ch = this->channels[channel_id];
+    bank &b = ch.banks[bank_id];
+    if (this->config.write_queue > 0 && this->try_write_queue(ch, b, req, cycle)) {
+        return true;
+    }
+    if (req.op == op_type::probe_write && this->config.write_queue > 0 && ch.writes_queued >= this->config.write_queue) {
+        // Back pressure, the write waits at the memory port.
+        this->write_stalls += 1;
+        return false;
+    }
+
+    if (!b.queue.empty() || b.busy_until > cycle) {
+        b.conflicts += 1;
+    }
+    b.queue.push_back(pending{req, cycle});
+    this->queued += 1;
+    return true;
+}
+
+bool MemoryController::cancel(const request &req) {
+    uint32_t channel_id, bank_id;
+    this->locate(req.addr, &channel_id, &bank_id);
+
+    deque<pending> &queue = this->channels[channel_id].banks[bank_id].queue;
+    for (auto it = queue.begin(); it != queue.end(); it++) {
+        if (it->req == req) {
+            queue.erase(it);
+            this->queued -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MemoryController::try_write_queue(channel &ch, bank &b, const request &req, uint64_t cycle) {
+    uint64_t line = req.addr / BLOCK_SIZE;
+
+    if (req.op != op_type::probe_write) {
+        for (const auto &w : b.writes) {
+            if (w.req.addr / BLOCK_SIZE == line) {
+                // The queued write has the latest data.
+                this->forwarded_reads += 1;
+                ch.reads += 1;
+                ch.read_latency += 1;
+                this->answered.push_back(access{req, cycle + 1});
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (auto &w : b.writes) {
+        if (w.req.addr / BLOCK_SIZE == line) {
+            w.req = req;
+            this->coalesced_writes += 1;
+            this->answered.push_back(access{req, cycle + 1});
+            return true;
+        }
+    }
+    for (const auto &p : b.queue) {
+        if (p.req.addr / BLOCK_SIZE == line) {
+            // A read of the line is still queued, the write stays behind it.
+            return false;
+        }
+    }
+    if (ch.writes_queued >= this->config.write_queue) {
+        return false;
+    }
+
+    b.writes.push_back(pending{req, cycle});
+    ch.writes_queued += 1;
+    this->queued += 1;
+    this->posted_writes += 1;
+    this->answered.push_back(access{req, cycle + 1});
+    return true;
+}
+
+uint64_t MemoryController::parked_writes() const {
+    uint64_t parked = 0;
+    for (const auto &ch : this->channels) {
+        if (ch.writes_queued <= this->config.write_low) {
+            parked += ch.writes_queued;
+        }
+    }
+    return parked;
+}
+
+bool MemoryController::serve_writes(const channel &ch, const bank &b) const {
+    if (b.writes.empty()) {
+        return false;
+    }
+    if (ch.draining) {
+        return true;
+    }
+    // Otherwise only above the low watermark and while no read waits
+    // anywhere in the channel.
+    return ch.writes_queued > this->config.write_low && all_of(ch.banks.begin(), ch.banks.end(), [](const bank &other) { return other.queue.empty(); });
+}
+
+void MemoryController::step(uint64_t cycle, std::vector<access> &started) {
+    started.insert(started.end(), this->answered.begin(), this->answered.end());
+    this->answered.clear();
+    if (this->idle()) {
+        return;
+    }
+    for (uint32_t channel_id = 0; channel_id < this->channels.size(); channel_id++) {
+        this->advance(channel_id, cycle);
+        channel &ch = this->channels[channel_id];
+
+        if (ch.writes_queued >= this->config.write_high && ch.writes_queued > 0 && !ch.draining) {
+            ch.draining = true;
+            this->drains += 1;
+        } else if (ch.writes_queued <= this->config.write_low) {
+            ch.draining = false;
+        }
+
+        for (uint32_t bank_id = 0; bank_id < ch.banks.size(); bank_id++) {
+            bank &b = ch.banks[bank_id];
+            if ((b.queue.empty() && b.writes.empty()) || !this->can_issue(channel_id, bank_id, cycle)) {
+                continue;
+            }
+            // Reads go first, posted writes when draining or when no read waits.
+            bool write = this->serve_writes(ch, b);
+            if (!write && b.queue.empty()) {
+                continue;
+            }
+            deque<pending> &queue = write ? b.writes : b.queue;
+            size_t index = this->pick(channel_id, bank_id, queue);
+            pending next = queue[index];
+            queue.erase(queue.begin() + (long) index);
+            this->queued -= 1;
+            if (write) {
+                ch.writes_queued -= 1;
+            }
+
+            b.accesses += 1;
+            b.wait_cycles += cycle - next.arrival;
+            ch.lines += 1;
+            uint64_t ready = this->issue(channel_id, bank_id, next, cycle);
+            if (write) {
+                continue; // acknowledged when it was queued.
+            }
+            if (next.req.op != op_type::probe_write) {
+                ch.reads += 1;
+                ch.read_latency += ready - next.arrival;
+            }
+            started.push_back(access{next.req, ready});
+        }
+    }
+}
+
+bool MemoryController::can_issue(uint32_t channel_id, uint32_t bank_id, uint64_t cycle) const {
+    return this->channels[channel_id].banks[bank_id].busy_until <= cycle;
+}
+
+uint64_t MemoryController::issue(uint32_t channel_id, uint32_t bank_id, const pending &next, uint64_t cycle) {
+    channel &ch = this->channels[channel_id];
+    ch.banks[bank_id].busy_until = cycle + this->config.bank_busy;
+
+    // The line leaves over the data bus of the channel, one after another.
+    uint64_t ready = max(cycle + MEMORY_LATENCY, ch.data_busy_until + this->transfer_cycles);
+    ch.data_busy_until = ready;
+    return ready;
+}
+
+void MemoryController::print_stats(std::ostream &os, uint64_t cycles) const {
+    char line[256];
+    snprintf(line, sizeof(line), "Memory: %u channel(s) x %u bank(s), %s interleaved, %u cycle(s) per bank access",
+             this->config.num_channels, this->config.num_banks, this->mapping_name(), this->config.bank_busy);
+    os << line << endl;
+    this->print_channels(os, cycles);
+}
+
+const char *MemoryController::mapping_name() const {
+    static const char *mappings[] = {"line", "page", "xor"};
+    return mappings[this->config.mapping];
+}
+
+void MemoryController::print_channels(std::ostream &os, uint64_t cycles) const {
+    char line[256];
+    os << "Channel\tLines\tBytes/Cycle\tDataUtil\tConflicts\tAvgBankWait\tAvgReadLat" << endl;
+
+    for (uint32_t i = 0; i < this->channels.size(); i++) {
+        const channel &ch = this->channels[i];
+        uint64_t accesses = 0, conflicts = 0, wait_cycles = 0;
+        for (const auto &b : ch.banks) {
+            accesses += b.accesses;
+            conflicts += b.conflicts;
+            wait_cycles += b.wait_cycles;
+        }
+        snprintf(line, sizeof(line), "%u\t%lu\t%f\t%f\t%lu\t\t%f\t%f", i, (unsigned long) ch.lines,
+                 cycles ? (double) ch.lines * BLOCK_SIZE / cycles : 0,
+                 cycles ? (double) ch.lines * this->transfer_cycles / cycles : 0, (unsigned long) conflicts,
+                 accesses ? (double) wait_cycles / accesses : 0, ch.reads ? (double) ch.read_latency / ch.reads : 0);
+        os << line << endl;
+    }
+
+    if (this->config.write_queue == 0) {
+        return;
+    }
+    snprintf(line, sizeof(line), "Write queue: %u per channel, drain from %u down to %u", this->config.write_queue,
+             this->config.write_high, this->config.write_low);
+    os << line << endl;
+    os << "Posted\tCoalesced\tForwarded\tDrains\tStalls" << endl;
+    snprintf(line, sizeof(line), "%lu\t%lu\t\t%lu\t\t%lu\t%lu", (unsigned long) this->posted_writes,
+             (unsigned long) this->coalesced_writes, (unsigned long) this->forwarded_reads,
+             (unsigned long) this->drains, (unsigned long) this->write_stalls);
+    os << line << endl;
+}
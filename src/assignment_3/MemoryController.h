@@ -0,0 +1,147 @@
+//
+// Created by yanghoo on 3/11/24.
+//
+
+#ifndef FRAMEWORK_MEMORY_CONTROLLER_H
+#define FRAMEWORK_MEMORY_CONTROLLER_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+#include "config.h"
+#include "lru.h"
+#include "types.h"
+
+static const uint32_t MEMORY_LATENCY = 100; // cycles from the start of an access to its data.
+static const uint32_t ROW_SIZE = 2048;      // bytes, the unit of page interleaving.
+
+typedef struct memory_config {
+    uint32_t num_channels;
+    uint32_t num_banks;     // per channel.
+    uint32_t bank_busy;     // cycles a bank is occupied by one access.
+    uint32_t channel_width; // bytes per cycle on the data bus of a channel.
+    enum memory_mapping mapping;
+    uint32_t write_queue; // posted writes per channel, 0 keeps writes in the bank queues.
+    uint32_t write_high;  // start draining writes at this many.
+    uint32_t write_low;   // stop draining at this many.
+} memory_config;
+
+/*
+ * Memory channels with independent banks. Every bank has its own queue and
+ * serves one access at a time, an access occupies its bank for bank_busy
+ * cycles and its data is ready MEMORY_LATENCY cycles after it started, once
+ * the data bus of the channel is free. Requests to different banks overlap,
+ * requests to the same line stay in order because they share a bank.
+ * With a write queue, writes are acknowledged once they are queued, a write
+ * to a line that is already queued replaces it and a read of such a line is
+ * answered from the queue. Reads go first until a channel holds write_high
+ * writes, then its banks drain writes down to write_low.
+ * Subclasses replace the bank timing and the order a bank serves its queue.
+ */
+class MemoryController {
+public:
+    typedef struct access {
+        request req;
+        uint64_t ready; // cycle the data has left the channel.
+    } access;
+
+    explicit MemoryController(const memory_config &config);
+
+    virtual ~MemoryController() = default;
+
+    // The controller the configuration asks for.
+    static MemoryController *create(const sim_config &config);
+
+    // False if the write queue of the channel is full, the request has to
+    // be offered again.
+    bool enqueue(const request &req, uint64_t cycle);
+
+    // Removes a read that still waits for its bank, false if it started.
+    bool cancel(const request &req);
+
+    // Starts the accesses whose bank is free at `cycle` and appends the
+    // responses, including the ones that did not need a bank, to `started`.
+    void step(uint64_t cycle, std::vector<access> &started);
+
+    // Nothing can start, writes below the low watermark wait for company.
+    bool idle() const {
+        return this->queued == this->parked_writes();
+    }
+
+    virtual void print_stats(std::ostream &os, uint64_t cycles) const;
+
+protected:
+    typedef struct pending {
+        request req;
+        uint64_t arrival;
+    } pending;
+
+    typedef struct bank {
+        std::deque<pending> queue;
+        std::deque<pending> writes; // posted writes.
+        uint64_t busy_until;
+        uint64_t accesses;
+        uint64_t conflicts; // arrivals that found the bank busy or queued.
+        uint64_t wait_cycles;
+    } bank;
+
+    typedef struct channel {
+        std::vector<bank> banks;
+        uint64_t data_busy_until;
+        uint64_t lines;
+        uint64_t reads;
+        uint64_t read_latency;
+        uint32_t writes_queued;
+        bool draining;
+    } channel;
+
+    memory_config config;
+    uint32_t transfer_cycles; // data bus cycles per cache line.
+    std::vector<channel> channels;
+    uint64_t queued = 0;
+    // Responses of posted writes and forwarded reads.
+    std::vector<access> answered;
+
+    uint64_t posted_writes = 0;
+    uint64_t coalesced_writes = 0;
+    uint64_t forwarded_reads = 0;
+    uint64_t drains = 0;
+    uint64_t write_stalls = 0;
+
+    // Channel and bank of an address under the configured mapping.
+    void locate(uint64_t addr, uint32_t *channel_id, uint32_t *bank_id) const;
+
+    const char *mapping_name() const;
+
+    // Lines, bandwidth and bank conflicts per channel.
+    void print_channels(std::ostream &os, uint64_t cycles) const;
+
+    // Called once per channel and step, before its banks issue.
+    virtual void advance(uint32_t channel_id, uint64_t cycle) {}
+
+    virtual bool can_issue(uint32_t channel_id, uint32_t bank_id, uint64_t cycle) const;
+
+    // Index in `queue`, the read or the write queue of the bank, of the
+    // access to start next.
+    virtual size_t pick(uint32_t channel_id, uint32_t bank_id, const std::deque<pending> &queue) {
+        return 0;
+    }
+
+    uint64_t parked_writes() const;
+
+    // Whether the bank serves its posted writes instead of its queue.
+    bool serve_writes(const channel &ch, const bank &b) const;
+
+    // Times an access that starts at `cycle`, returns the cycle its data has
+    // left the channel.
+    virtual uint64_t issue(uint32_t channel_id, uint32_t bank_id, const pending &next, uint64_t cycle);
+
+private:
+    // Posts a write or forwards a read through the write queue, false if
+    // the request has to go through the bank queue.
+    bool try_write_queue(channel &ch, bank &b, const request &req, uint64_t cycle);
+};
+
+#endif //FRAMEWORK_MEMORY_CONTROLLER_H
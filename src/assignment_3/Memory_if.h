@@ -2,6 +2,7 @@
 // Created by yanghoo on 2/24/24.
 //
 #include <systemc.h>
+#include "ring_buffer.h"
 #include "types.h"
 
 #ifndef FRAMEWORK_MEMORY_IF_H
@@ -11,10 +12,15 @@
  * to the cache. */
 class Memory_if: public virtual sc_interface {
 public:
-    virtual int read(request) = 0;
-    virtual int write(request) = 0;
-    virtual void ack() = 0;
-    virtual std::vector<request> get_requests() = 0;
+    virtual int read(const request &) = 0;
+    virtual int write(const request &) = 0;
+    // A read issued before the snoop that may be cancelled.
+    virtual int speculative_read(const request &) = 0;
+    // Drops a speculative read, a cache supplies the line.
+    virtual void cancel(const request &) = 0;
+    virtual void ack(uint32_t bus_id) = 0;
+    // The responses for bus `bus_id`, the bus drains them in place.
+    virtual RingBuffer<request> &send_buffer(uint32_t bus_id) = 0;
 };
 
 #endif //FRAMEWORK_MEMORY_IF_H
@@ -0,0 +1,312 @@
+//
+// Created by yanghoo on 3/9/24.
+//
+#include "Network.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+Network::Network(const network_config &config) : config(config) {
+    uint32_t num_routers;
+    if (config.shape == topology::ring) {
+        this->num_ports = 3; // local, clockwise, counter clockwise.
+        this->width = config.num_nodes;
+        num_routers = config.num_nodes;
+    } else {
+        this->num_ports = 5; // local, east, west, south, north.
+        this->width = (uint32_t) ceil(sqrt((double) config.num_nodes));
+        // Fill the last row with routers without an endpoint, so XY routes
+        // never run off the mesh.
+        uint32_t height = (config.num_nodes + this->width - 1) / this->width;
+        num_routers = this->width * height;
+    }
+
+    router empty;
+    empty.inputs = vector<vector<virtual_channel>>(
+            this->num_ports, vector<virtual_channel>(config.num_vcs, virtual_channel{deque<packet>(), 0}));
+    empty.link_busy_until = vector<uint64_t>(this->num_ports, 0);
+    empty.link_flits = vector<uint64_t>(this->num_ports, 0);
+    empty.next_input = 0;
+    this->routers = vector<router>(num_routers, empty);
+}
+
+void Network::inject(uint64_t tag, uint32_t src, uint32_t dst, uint32_t flits, uint64_t cycle) {
+    packet p{tag, src, dst, flits, 0, false, false, 0, 0, cycle, cycle};
+    this->routers[src].injection.push_back(p);
+    this->in_flight += 1;
+}
+
+void Network::broadcast(uint32_t src, uint32_t flits, uint64_t cycle) {
+    packet p{0, src, src, flits, 0, false, true, 0, 0, cycle, cycle};
+    this->routers[src].injection.push_back(p);
+    this->in_flight += 1;
+}
+
+void Network::step(uint64_t cycle, std::vector<uint64_t> &delivered) {
+    if (this->idle()) {
+        return;
+    }
+    for (uint32_t node = 0; node < this->routers.size(); node++) {
+        this->accept_injections(node, cycle);
+    }
+    // A packet that moved this cycle is only ready hop_latency cycles later,
+    // so the order of the routers does not matter.
+    for (uint32_t node = 0; node < this->routers.size(); node++) {
+        this->forward(node, cycle, delivered);
+    }
+}
+
+void Network::accept_injections(uint32_t node, uint64_t cycle) {
+    router &r = this->routers[node];
+    while (!r.injection.empty()) {
+        int vc = this->pick_vc(r, 0, r.injection.front());
+        if (vc < 0) {
+            return;
+        }
+        this->enter(node, 0, vc, r.injection.front(), cycle);
+        r.injection.pop_front();
+    }
+}
+
+void Network::enter(uint32_t node, uint32_t port, uint32_t vc, packet p, uint64_t ready) {
+    p.ready_cycle = ready;
+    if (p.broadcast) {
+        p.pending_ports = this->tree_ports(node, p);
+    }
+    virtual_channel &channel = this->routers[node].inputs[port][vc];
+    channel.packets.push_back(p);
+    channel.used += p.flits;
+}
+
+void Network::forward(uint32_t node, uint64_t cycle, std::vector<uint64_t> &delivered) {
+    router &r = this->routers[node];
+    uint32_t total_vcs = this->num_ports * this->config.num_vcs;
+
+    for (uint32_t k = 0; k < total_vcs; k++) {
+        uint32_t index = (r.next_input + k) % total_vcs;
+        virtual_channel &in = r.inputs[index / this->config.num_vcs][index % this->config.num_vcs];
+        if (in.packets.empty() || in.packets.front().ready_cycle > cycle) {
+            continue;
+        }
+
+        if (in.packets.front().broadcast) {
+            this->forward_broadcast(node, in, cycle);
+            continue;
+        }
+
+        packet p = in.packets.front();
+        uint32_t out = this->route(node, p.dst);
+
+        if (out == 0) {
+            // Arrived, eject through the local port.
+            in.packets.pop_front();
+            in.used -= p.flits;
+            this->in_flight -= 1;
+            this->deliver(p, cycle);
+            delivered.push_back(p.tag);
+            continue;
+        }
+
+        if (this->send_hop(node, out, p, cycle)) {
+            in.packets.pop_front();
+            in.used -= p.flits;
+        }
+    }
+    r.next_input = (r.next_input + 1) % total_vcs;
+}
+
+void Network::forward_broadcast(uint32_t node, virtual_channel &in, uint64_t cycle) {
+    packet &p = in.packets.front();
+    for (uint32_t port = 0; port < this->num_ports; port++) {
+        if (!(p.pending_ports & (1u << port))) {
+            continue;
+        }
+        if (port == 0) {
+            this->deliver(p, cycle);
+            p.pending_ports &= ~1u;
+        } else if (this->send_hop(node, port, p, cycle)) {
+            p.pending_ports &= ~(1u << port);
+        }
+    }
+    // The buffer is freed once every branch of the tree got its copy.
+    if (p.pending_ports == 0) {
+        in.used -= p.flits;
+        in.packets.pop_front();
+        this->in_flight -= 1;
+    }
+}
+
+bool Network::send_hop(uint32_t node, uint32_t out, packet p, uint64_t cycle) {
+    router &r = this->routers[node];
+    if (r.link_busy_until[out] > cycle) {
+        return false;
+    }
+
+    uint32_t next = this->neighbour(node, out);
+    uint32_t in_port = this->opposite(out);
+    p.crossed_dateline = p.crossed_dateline || this->crosses_dateline(node, out);
+    int vc = this->pick_vc(this->routers[next], in_port, p);
+    if (vc < 0) {
+        // No credits downstream, the packet waits in its buffer.
+        this->credit_stalls += 1;
+        return false;
+    }
+
+    uint64_t serialization = (p.flits + this->config.link_bandwidth - 1) / this->config.link_bandwidth;
+    r.link_busy_until[out] = cycle + serialization;
+    r.link_flits[out] += p.flits;
+
+    p.hops += 1;
+    p.arrival_port = out;
+    if (p.broadcast) {
+        // A copy per branch, the original leaves once all are sent.
+        this->in_flight += 1;
+    }
+    this->enter(next, in_port, vc, p, cycle + this->config.hop_latency + serialization - 1);
+    return true;
+}
+
+void Network::deliver(const packet &p, uint64_t cycle) {
+    this->delivered_packets += 1;
+    this->broadcast_copies += p.broadcast ? 1 : 0;
+    this->total_hops += p.hops;
+    this->max_hops = max(this->max_hops, p.hops);
+    this->total_latency += cycle - p.inject_cycle;
+}
+
+int Network::pick_vc(const router &next, uint32_t port, const packet &p) const {
+    int best = -1;
+    uint32_t best_free = 0;
+
+    for (uint32_t vc = 0; vc < this->config.num_vcs; vc++) {
+        // Dateline classes: even channels before the wrap link, odd after.
+        // parse_config gives a ring at least two.
+        if (this->config.shape == topology::ring && port != 0 && (vc % 2) != (p.crossed_dateline ? 1u : 0u)) {
+            continue;
+        }
+        const virtual_channel &channel = next.inputs[port][vc];
+        uint32_t free = channel.used >= this->config.vc_depth ? 0 : this->config.vc_depth - channel.used;
+        // A packet longer than a buffer still fits in an empty one.
+        if ((free >= p.flits || channel.used == 0) && (best < 0 || free > best_free)) {
+            best = (int) vc;
+            best_free = free;
+        }
+    }
+    return best;
+}
+
+uint32_t Network::route(uint32_t node, uint32_t dst) const {
+    if (this->config.shape == topology::ring) {
+        uint32_t n = (uint32_t) this->routers.size();
+        uint32_t clockwise = (dst + n - node) % n;
+        if (clockwise == 0) return 0;
+        return clockwise <= n - clockwise ? 1 : 2;
+    }
+
+    // XY routing, first along the row then along the column.
+    uint32_t x = node % this->width, y = node / this->width;
+    uint32_t dst_x = dst % this->width, dst_y = dst / this->width;
+    if (dst_x > x) return 1;
+    if (dst_x < x) return 2;
+    if (dst_y > y) return 3;
+    if (dst_y < y) return 4;
+    return 0;
+}
+
+uint32_t Network::tree_ports(uint32_t node, const packet &p) const {
+    uint32_t local = node != p.src && node < this->config.num_nodes ? 1u : 0u;
+
+    if (this->config.shape == topology::ring) {
+        // Clockwise covers the first n / 2 nodes, counter clockwise the rest.
+        uint32_t n = (uint32_t) this->routers.size();
+        uint32_t clockwise = n / 2, counter = n - 1 - n / 2;
+        if (node == p.src) {
+            return (clockwise > 0 ? 1u << 1 : 0) | (counter > 0 ? 1u << 2 : 0);
+        }
+        if (p.arrival_port == 1 && (node + n - p.src) % n < clockwise) {
+            return local | 1u << 1;
+        }
+        if (p.arrival_port == 2 && (p.src + n - node) % n < counter) {
+            return local | 1u << 2;
+        }
+        return local;
+    }
+
+    // Along the source row, then up and down every column.
+    uint32_t height = (uint32_t) this->routers.size() / this->width;
+    uint32_t x = node % this->width, y = node / this->width;
+    uint32_t src_x = p.src % this->width, src_y = p.src / this->width;
+    uint32_t ports = local;
+    if (y == src_y) {
+        if (x >= src_x && x + 1 < this->width) ports |= 1u << 1;
+        if (x <= src_x && x > 0) ports |= 1u << 2;
+    }
+    if (y >= src_y && y + 1 < height) ports |= 1u << 3;
+    if (y <= src_y && y > 0) ports |= 1u << 4;
+    return ports;
+}
+
+uint32_t Network::neighbour(uint32_t node, uint32_t port) const {
+    if (this->config.shape == topology::ring) {
+        uint32_t n = (uint32_t) this->routers.size();
+        return port == 1 ? (node + 1) % n : (node + n - 1) % n;
+    }
+    switch (port) {
+        case 1:
+            return node + 1;
+        case 2:
+            return node - 1;
+        case 3:
+            return node + this->width;
+        default:
+            return node - this->width;
+    }
+}
+
+uint32_t Network::opposite(uint32_t port) const {
+    // east <-> west, south <-> north, clockwise <-> counter clockwise.
+    return port % 2 == 1 ? port + 1 : port - 1;
+}
+
+bool Network::crosses_dateline(uint32_t node, uint32_t port) const {
+    if (this->config.shape != topology::ring) {
+        return false;
+    }
+    uint32_t n = (uint32_t) this->routers.size();
+    return (port == 1 && node == n - 1) || (port == 2 && node == 0);
+}
+
+void Network::print_stats(std::ostream &os, uint64_t cycles) const {
+    uint64_t links = 0, flits = 0, busiest = 0;
+    uint32_t height = (uint32_t) this->routers.size() / this->width;
+
+    for (uint32_t node = 0; node < this->routers.size(); node++) {
+        uint32_t x = node % this->width, y = node / this->width;
+        for (uint32_t port = 1; port < this->num_ports; port++) {
+            if (this->config.shape == topology::mesh
+                && ((port == 1 && x + 1 == this->width) || (port == 2 && x == 0)
+                    || (port == 3 && y + 1 == height) || (port == 4 && y == 0))) {
+                continue; // edge of the mesh, no link.
+            }
+            links += 1;
+            flits += this->routers[node].link_flits[port];
+            busiest = max(busiest, this->routers[node].link_flits[port]);
+        }
+    }
+
+    double capacity = (double) cycles * this->config.link_bandwidth;
+    char line[256];
+    snprintf(line, sizeof(line), "NoC: %s, %lu routers, %lu links, %u vcs x %u flits",
+             this->config.shape == topology::ring ? "ring" : "mesh", (unsigned long) this->routers.size(),
+             (unsigned long) links, this->config.num_vcs, this->config.vc_depth);
+    os << line << endl;
+    os << "Packets\tBroadcast\tAvgHops\t\tMaxHops\tAvgLatency\tAvgLinkUtil\tMaxLinkUtil\tCreditStalls" << endl;
+    snprintf(line, sizeof(line), "%lu\t%lu\t\t%f\t%u\t%f\t%f\t%f\t%lu", (unsigned long) this->delivered_packets,
+             (unsigned long) this->broadcast_copies,
+             this->delivered_packets ? (double) this->total_hops / this->delivered_packets : 0, this->max_hops,
+             this->delivered_packets ? (double) this->total_latency / this->delivered_packets : 0,
+             links && capacity > 0 ? (double) flits / (links * capacity) : 0,
+             capacity > 0 ? (double) busiest / capacity : 0, (unsigned long) this->credit_stalls);
+    os << line << endl;
+}
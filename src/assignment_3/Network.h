@@ -0,0 +1,131 @@
+//
+// Created by yanghoo on 3/9/24.
+//
+
+#ifndef FRAMEWORK_NETWORK_H
+#define FRAMEWORK_NETWORK_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+enum topology {
+    ring = 0, // bidirectional ring, shortest direction.
+    mesh = 1, // 2D mesh with XY routing.
+};
+
+typedef struct network_config {
+    topology shape;
+    uint32_t num_nodes;
+    uint32_t hop_latency;    // cycles through one router and link.
+    uint32_t link_bandwidth; // flits per cycle.
+    uint32_t num_vcs;        // virtual channels per input port.
+    uint32_t vc_depth;       // flits per virtual channel.
+} network_config;
+
+/*
+ * Packet switched network with credit based flow control.
+ * Every router has a local port and one port per neighbour. A packet moves
+ * a hop at a time (virtual cut-through): it needs enough credits in one
+ * virtual channel of the next router, then occupies the link for
+ * flits / link_bandwidth cycles and arrives hop_latency cycles later.
+ * The ring uses a dateline, packets that wrapped around move to the odd
+ * virtual channels so the ring cannot deadlock.
+ * Broadcasts are replicated along a spanning tree (both ways round the ring,
+ * the source row then every column of the mesh), a router forwards a copy
+ * on every tree port before the packet leaves its buffer.
+ */
+class Network {
+public:
+    typedef struct packet {
+        uint64_t tag; // owner defined, handed back on delivery.
+        uint32_t src;
+        uint32_t dst;
+        uint32_t flits;
+        uint32_t hops;
+        bool crossed_dateline;
+        bool broadcast;
+        uint32_t arrival_port; // output port of the previous router.
+        uint32_t pending_ports; // broadcast: tree ports (bit 0 is local) still to serve.
+        uint64_t inject_cycle;
+        uint64_t ready_cycle; // cycle the packet is at the head of its buffer.
+    } packet;
+
+    explicit Network(const network_config &config);
+
+    void inject(uint64_t tag, uint32_t src, uint32_t dst, uint32_t flits, uint64_t cycle);
+
+    // Sends a copy to every other node, the copies are not handed back by step.
+    void broadcast(uint32_t src, uint32_t flits, uint64_t cycle);
+
+    // Advances the network to `cycle` and appends the tags of the packets
+    // that reached their destination.
+    void step(uint64_t cycle, std::vector<uint64_t> &delivered);
+
+    bool idle() const {
+        return this->in_flight == 0;
+    }
+
+    void print_stats(std::ostream &os, uint64_t cycles) const;
+
+private:
+    typedef struct virtual_channel {
+        std::deque<packet> packets;
+        uint32_t used; // flits, the free credits are vc_depth - used.
+    } virtual_channel;
+
+    typedef struct router {
+        // [port][vc], port 0 is the local injection port.
+        std::vector<std::vector<virtual_channel>> inputs;
+        std::vector<uint64_t> link_busy_until; // per output port.
+        std::vector<uint64_t> link_flits;      // per output port.
+        std::deque<packet> injection;
+        uint32_t next_input; // round robin over input virtual channels.
+    } router;
+
+    network_config config;
+    uint32_t num_ports;
+    uint32_t width; // mesh columns.
+    std::vector<router> routers;
+    uint64_t in_flight = 0;
+
+    uint64_t delivered_packets = 0;
+    uint64_t broadcast_copies = 0;
+    uint64_t total_hops = 0;
+    uint32_t max_hops = 0;
+    uint64_t total_latency = 0;
+    uint64_t credit_stalls = 0;
+
+    uint32_t route(uint32_t node, uint32_t dst) const;
+
+    // Bit mask of the spanning tree ports of a broadcast packet at `node`.
+    uint32_t tree_ports(uint32_t node, const packet &p) const;
+
+    // Places a packet in a virtual channel of `node`.
+    void enter(uint32_t node, uint32_t port, uint32_t vc, packet p, uint64_t ready);
+
+    // Moves a copy of `p` one hop through `out`, false if the link is busy or
+    // the next router has no room.
+    bool send_hop(uint32_t node, uint32_t out, packet p, uint64_t cycle);
+
+    void deliver(const packet &p, uint64_t cycle);
+
+    void forward_broadcast(uint32_t node, virtual_channel &in, uint64_t cycle);
+
+    uint32_t neighbour(uint32_t node, uint32_t port) const;
+
+    // Input port of the neighbour that a link out of `port` ends on.
+    uint32_t opposite(uint32_t port) const;
+
+    bool crosses_dateline(uint32_t node, uint32_t port) const;
+
+    // A virtual channel at the next router with room for the packet, or -1.
+    int pick_vc(const router &next, uint32_t port, const packet &p) const;
+
+    void accept_injections(uint32_t node, uint64_t cycle);
+
+    void forward(uint32_t node, uint64_t cycle, std::vector<uint64_t> &delivered);
+};
+
+#endif //FRAMEWORK_NETWORK_H
@@ -0,0 +1,92 @@
+//
+// Created by yanghoo on 3/9/24.
+//
+#include "Noc.h"
+
+Noc::Noc(sc_module_name name_, const SimulationContext &context, const sim_config &config)
+        : Bus(name_, context, config, 0) {
+    network_config network;
+    network.shape = config.interconnect == interconnect::mesh_noc ? topology::mesh : topology::ring;
+    network.num_nodes = context.num_cpus + 1;
+    network.hop_latency = config.hop_latency;
+    network.link_bandwidth = config.link_bandwidth;
+    network.num_vcs = config.num_vcs;
+    network.vc_depth = config.vc_depth;
+
+    this->network = new Network(network);
+    this->home_node = context.num_cpus;
+    // Header flit plus the payload.
+    this->line_flits = 1 + (BLOCK_SIZE + FLIT_SIZE - 1) / FLIT_SIZE;
+}
+
+Noc::~Noc() {
+    delete this->network;
+}
+
+int Noc::try_request(request_id req) {
+    if (req.source == location::memory) {
+        // The memory controller sits at the ordering point.
+        return Bus::try_request(req);
+    }
+    this->send(message{message_type::bus_request, req, request()}, req.cpu_id, this->home_node, 1);
+    this->wake.notify(SC_ZERO_TIME);
+    return 0;
+}
+
+void Noc::send_to_cpus(const request &req) {
+    // Ordered and applied at the ordering point, the broadcast only models
+    // the load the snoop puts on the links.
+    Bus::send_to_cpus(req);
+    this->network->broadcast(this->home_node, 1, current_cycle());
+}
+
+void Noc::transfer_data(const request &req) {
+    uint32_t src = req.source == location::memory ? this->home_node : req.sender_id;
+    // Write backs go to the memory controller, everything else to a cache.
+    uint32_t dst = req.op == op_type::data_transfer ? req.receiver_id : this->home_node;
+    this->send(message{message_type::line, request_id(), req}, src, dst, this->line_flits);
+}
+
+bool Noc::advance(uint64_t cycle) {
+    this->delivered.clear();
+    this->network->step(cycle, this->delivered);
+
+    for (auto slot : this->delivered) {
+        const message &msg = this->messages[slot];
+        this->free_slots.push_back(slot);
+
+        switch (msg.type) {
+            case bus_request:
+                Bus::try_request(msg.id);
+                break;
+            case line:
+                this->finish_data_phase(msg.req);
+                break;
+        }
+    }
+    // The ordering point grants one burst per cycle.
+    return true;
+}
+
+uint64_t Noc::next_work(uint64_t cycle) const {
+    // Packets move every cycle.
+    return this->network->idle() ? Bus::next_work(cycle) : cycle + 1;
+}
+
+void Noc::send(const message &msg, uint32_t src, uint32_t dst, uint32_t flits) {
+    uint64_t slot;
+    if (this->free_slots.empty()) {
+        slot = this->messages.size();
+        this->messages.push_back(msg);
+    } else {
+        slot = this->free_slots.back();
+        this->free_slots.pop_back();
+        this->messages[slot] = msg;
+    }
+    this->network->inject(slot, src, dst, flits, current_cycle());
+}
+
+void Noc::print_stats() const {
+    Bus::print_stats();
+    this->network->print_stats(cout, current_cycle());
+}
@@ -0,0 +1,63 @@
+//
+// Created by yanghoo on 3/9/24.
+//
+
+#ifndef FRAMEWORK_NOC_H
+#define FRAMEWORK_NOC_H
+
+#include "Bus.h"
+#include "Network.h"
+
+static const uint32_t FLIT_SIZE = 16; // Bytes.
+
+/*
+ * Network-on-chip interconnect. Cache i sits on node i, the memory
+ * controller and the ordering point on node num_cpus. A cache request
+ * travels to the ordering point before it enters arbitration, snoops are
+ * ordered there and broadcast to every cache, and cache lines travel from
+ * the node that has them to the node that wants them. The coherence
+ * decisions are the ones of the Bus it extends.
+ */
+class Noc : public Bus {
+public:
+    Noc(sc_module_name name_, const SimulationContext &context, const sim_config &config);
+
+    ~Noc() override;
+
+    int try_request(request_id) override;
+
+    void send_to_cpus(const request &req) override;
+
+    void transfer_data(const request &req) override;
+
+    void print_stats() const override;
+
+protected:
+    bool advance(uint64_t cycle) override;
+
+    uint64_t next_work(uint64_t cycle) const override;
+
+private:
+    enum message_type {
+        bus_request = 0, // delivered to the arbiter at the ordering point.
+        line = 1,        // a cache line for a cache or the memory.
+    };
+
+    typedef struct message {
+        message_type type;
+        request_id id;
+        request req;
+    } message;
+
+    Network *network;
+    uint32_t home_node;
+    uint32_t line_flits;
+    // In flight messages, the network packets carry the slot index.
+    vector<message> messages;
+    vector<uint64_t> free_slots;
+    vector<uint64_t> delivered;
+
+    void send(const message &msg, uint32_t src, uint32_t dst, uint32_t flits);
+};
+
+#endif //FRAMEWORK_NOC_H
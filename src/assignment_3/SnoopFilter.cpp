@@ -0,0 +1,197 @@
+//
+// Created by yanghoo on 3/15/24.
+//
+#include "SnoopFilter.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "types.h"
+
+using namespace std;
+
+SnoopFilter::SnoopFilter(uint32_t num_caches) : words((num_caches + 63) / 64) {
+    if (num_caches > MAX_CPUS) {
+        throw runtime_error("Error, " + to_string(num_caches) + " processors, a request addresses at most "
+                            + to_string(MAX_CPUS) + "\n");
+    }
+    // The lines of a few caches before the first grow.
+    this->slots = vector<entry>(1024, entry{NO_LINE, 0, {0, 0, 0}, NO_BITS});
+}
+
+size_t SnoopFilter::find(uint64_t line) const {
+    size_t mask = this->slots.size() - 1;
+    for (size_t slot = this->home(line); this->slots[slot].line != NO_LINE; slot = (slot + 1) & mask) {
+        if (this->slots[slot].line == line) {
+            return slot;
+        }
+    }
+    return this->slots.size();
+}
+
+SnoopFilter::entry &SnoopFilter::insert(uint64_t line) {
+    size_t slot = this->find(line);
+    if (slot != this->slots.size()) {
+        return this->slots[slot];
+    }
+    if ((this->used + 1) * 2 > this->slots.size()) {
+        // Twice the slots, every line goes to its place in the larger table.
+        vector<entry> old(this->slots.size() * 2, entry{NO_LINE, 0, {0, 0, 0}, NO_BITS});
+        old.swap(this->slots);
+        size_t mask = this->slots.size() - 1;
+        for (const entry &e : old) {
+            if (e.line == NO_LINE) {
+                continue;
+            }
+            size_t to = this->home(e.line);
+            while (this->slots[to].line != NO_LINE) {
+                to = (to + 1) & mask;
+            }
+            this->slots[to] = e;
+        }
+    }
+    size_t mask = this->slots.size() - 1;
+    slot = this->home(line);
+    while (this->slots[slot].line != NO_LINE) {
+        slot = (slot + 1) & mask;
+    }
+    this->used += 1;
+    entry &e = this->slots[slot];
+    e.line = line;
+    e.count = 0;
+    e.bits = NO_BITS;
+    return e;
+}
+
+void SnoopFilter::erase(size_t slot) {
+    size_t mask = this->slots.size() - 1;
+    size_t hole = slot;
+    // A line behind the hole moves into it unless its home lies between
+    // the hole and where it is now.
+    for (size_t next = (hole + 1) & mask; this->slots[next].line != NO_LINE; next = (next + 1) & mask) {
+        size_t want = this->home(this->slots[next].line);
+        if (((next - want) & mask) >= ((next - hole) & mask)) {
+            this->slots[hole] = this->slots[next];
+            hole = next;
+        }
+    }
+    this->slots[hole].line = NO_LINE;
+    this->used -= 1;
+}
+
+uint32_t SnoopFilter::take_block() {
+    uint32_t block;
+    if (this->free_blocks.empty()) {
+        block = (uint32_t) (this->pool.size() / this->words);
+        this->pool.resize(this->pool.size() + this->words, 0);
+    } else {
+        block = this->free_blocks.back();
+        this->free_blocks.pop_back();
+    }
+    return block;
+}
+
+void SnoopFilter::release_block(entry &e) {
+    if (e.bits == NO_BITS) {
+        return;
+    }
+    uint64_t *bits = this->bits_of(e);
+    fill(bits, bits + this->words, 0);
+    this->free_blocks.push_back(e.bits);
+    e.bits = NO_BITS;
+}
+
+void SnoopFilter::add(uint32_t cache, uint64_t addr) {
+    entry &e = this->insert(line_of(addr));
+    if (e.bits != NO_BITS) {
+        uint64_t *bits = this->bits_of(e);
+        uint64_t bit = 1ULL << (cache % 64);
+        if (!(bits[cache / 64] & bit)) {
+            bits[cache / 64] |= bit;
+            e.count += 1;
+        }
+        return;
+    }
+
+    uint32_t i = 0;
+    while (i < e.count && e.ids[i] < cache) {
+        i++;
+    }
+    if (i < e.count && e.ids[i] == cache) {
+        return;
+    }
+    if (e.count < INLINE_SHARERS) {
+        for (uint32_t j = e.count; j > i; j--) {
+            e.ids[j] = e.ids[j - 1];
+        }
+        e.ids[i] = (uint16_t) cache;
+        e.count += 1;
+        return;
+    }
+
+    // One more than fits in place, the line takes a bit per cache.
+    e.bits = this->take_block();
+    uint64_t *bits = this->bits_of(e);
+    for (uint32_t j = 0; j < e.count; j++) {
+        bits[e.ids[j] / 64] |= 1ULL << (e.ids[j] % 64);
+    }
+    bits[cache / 64] |= 1ULL << (cache % 64);
+    e.count += 1;
+}
+
+void SnoopFilter::remove(uint32_t cache, uint64_t addr) {
+    size_t slot = this->find(line_of(addr));
+    if (slot == this->slots.size()) {
+        return;
+    }
+    entry &e = this->slots[slot];
+    if (e.bits != NO_BITS) {
+        uint64_t *bits = this->bits_of(e);
+        uint64_t bit = 1ULL << (cache % 64);
+        if (bits[cache / 64] & bit) {
+            bits[cache / 64] &= ~bit;
+            e.count -= 1;
+        }
+    } else {
+        uint32_t i = 0;
+        while (i < e.count && e.ids[i] != cache) {
+            i++;
+        }
+        if (i == e.count) {
+            return;
+        }
+        for (e.count -= 1; i < e.count; i++) {
+            e.ids[i] = e.ids[i + 1];
+        }
+    }
+    if (e.count == 0) {
+        this->release_block(e);
+        this->erase(slot);
+    }
+}
+
+void SnoopFilter::invalidate_others(uint32_t writer, uint64_t addr) {
+    entry &e = this->insert(line_of(addr));
+    this->release_block(e);
+    e.ids[0] = (uint16_t) writer;
+    e.count = 1;
+}
+
+void SnoopFilter::sharers(uint64_t addr, vector<uint32_t> &out) const {
+    out.clear();
+    size_t slot = this->find(line_of(addr));
+    if (slot == this->slots.size()) {
+        return;
+    }
+    const entry &e = this->slots[slot];
+    if (e.bits == NO_BITS) {
+        out.insert(out.end(), e.ids, e.ids + e.count);
+        return;
+    }
+    const uint64_t *bits = this->bits_of(e);
+    for (size_t w = 0; w < this->words && out.size() < e.count; w++) {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+            out.push_back((uint32_t) (w * 64 + __builtin_ctzll(word)));
+        }
+    }
+}
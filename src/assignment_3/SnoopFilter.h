@@ -0,0 +1,95 @@
+//
+// Created by yanghoo on 3/15/24.
+//
+
+#ifndef FRAMEWORK_SNOOP_FILTER_H
+#define FRAMEWORK_SNOOP_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * The caches that hold a line, so a snoop visits the sharers of its line
+ * instead of every cache. The owner of the caches reports the lines a cache
+ * takes, also a line a hit puts back after a snoop invalidated it, and the
+ * lines it evicts. A write leaves the writer as the only sharer.
+ * A cache may stay listed after it lost a line without a report, callers
+ * still check the cache itself, but a cache that holds a line is always
+ * listed.
+ * A line with few sharers keeps their ids in place, only one with more
+ * takes a bit per cache, so most lines cost the same for 4 or 65536 caches.
+ * The lines sit in an open addressed table and the bits in a pool, both
+ * reuse their space, so once they hold the lines of every cache nothing
+ * is allocated any more.
+ */
+class SnoopFilter {
+public:
+    // Throws runtime_error for more caches than the ids of a request hold.
+    explicit SnoopFilter(uint32_t num_caches);
+
+    void add(uint32_t cache, uint64_t addr);
+
+    void remove(uint32_t cache, uint64_t addr);
+
+    // A write of `writer`, every other cache lost the line.
+    void invalidate_others(uint32_t writer, uint64_t addr);
+
+    // Replaces `out` with the sharers of the line of `addr`, in id order.
+    void sharers(uint64_t addr, std::vector<uint32_t> &out) const;
+
+    // Lines with at least one sharer.
+    size_t lines() const {
+        return this->used;
+    }
+
+private:
+    static const uint32_t INLINE_SHARERS = 3;
+    static const uint64_t NO_LINE = ~0ULL;   // a free slot.
+    static const uint32_t NO_BITS = ~0U;
+
+    typedef struct entry {
+        uint64_t line;                    // NO_LINE if the slot is free.
+        uint32_t count;                   // sharers.
+        uint16_t ids[INLINE_SHARERS];     // ascending, while bits is NO_BITS.
+        uint32_t bits;                    // its block of the pool, once there were more.
+    } entry;
+
+    size_t words; // of a block of bits.
+    // Linear probing over a power of two of slots, at most half of them used.
+    std::vector<entry> slots;
+    size_t used = 0;
+    std::vector<uint64_t> pool;       // blocks of `words` bits.
+    std::vector<uint32_t> free_blocks;
+
+    static uint64_t line_of(uint64_t addr) {
+        return addr >> 5;
+    }
+
+    size_t home(uint64_t line) const {
+        return (size_t) ((line * 0x9E3779B97F4A7C15ULL) >> 32) & (this->slots.size() - 1);
+    }
+
+    // The slot of `line`, slots.size() if it has no sharer.
+    size_t find(uint64_t line) const;
+
+    // The entry of `line`, a new one without sharers if it had none.
+    entry &insert(uint64_t line);
+
+    // Frees the slot, the lines behind it move up so probing stays intact.
+    void erase(size_t slot);
+
+    uint64_t *bits_of(const entry &e) {
+        return &this->pool[(size_t) e.bits * this->words];
+    }
+
+    const uint64_t *bits_of(const entry &e) const {
+        return &this->pool[(size_t) e.bits * this->words];
+    }
+
+    uint32_t take_block();
+
+    void release_block(entry &e);
+};
+
+#endif //FRAMEWORK_SNOOP_FILTER_H
@@ -0,0 +1,91 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+#include "TraceBuffer.h"
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+TraceBuffer::TraceBuffer(const char *tracefile, uint32_t num_cpus) : num_cpus(num_cpus), ended(0) {
+    // The header is the signature and the number of processors, 4 bytes each.
+    ifstream file(tracefile, ios::in | ios::binary);
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    file.seekg(8);
+    if (!file.good() || size < 8) {
+        throw runtime_error(string("Unable to read file: ") + tracefile);
+    }
+
+    // A partial entry at the end is not read, like in TraceFile.
+    this->storage = vector<unsigned char>((size_t) (size - 8) / 8 * 8);
+    file.read((char *) this->storage.data(), (streamsize) this->storage.size());
+    if (file.fail()) {
+        throw runtime_error(string("Unable to read file: ") + tracefile);
+    }
+    this->entries = this->storage.data();
+    this->count = this->storage.size() / 8;
+
+    this->positions = vector<size_t>(num_cpus);
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        this->positions[i] = i;
+    }
+}
+
+TraceBuffer::TraceBuffer(const unsigned char *file, size_t size, uint32_t num_cpus) : num_cpus(num_cpus), ended(0) {
+    if (size < 8) {
+        throw runtime_error("Unable to read the tracefile");
+    }
+    this->entries = file + 8;
+    this->count = (size - 8) / 8;
+
+    this->positions = vector<size_t>(num_cpus);
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        this->positions[i] = i;
+    }
+}
+
+uint64_t TraceBuffer::position(uint32_t id) const {
+    return this->ended_for(id) ? 0 : (this->positions[id] - id) / this->num_cpus;
+}
+
+void TraceBuffer::seek(uint32_t id, uint64_t position, bool finished) {
+    if (finished && !this->ended_for(id)) {
+        this->ended += 1;
+    } else if (!finished && this->ended_for(id)) {
+        this->ended -= 1;
+    }
+    if (finished) {
+        this->positions[id] = SIZE_MAX;
+        return;
+    }
+    size_t target = (size_t) position * this->num_cpus + id;
+    if (target > this->count + this->num_cpus) {
+        throw runtime_error("Seek past the end of the tracefile");
+    }
+    this->positions[id] = target;
+}
+
+TraceFile::EntryType TraceBuffer::next(uint32_t id, uint64_t *addr) {
+    size_t &position = this->positions[id];
+    if (position == SIZE_MAX) {
+        return TraceFile::ENTRY_TYPE_NOP;
+    }
+    if (position >= this->count) {
+        // No end tag, the trace stops with the file.
+        position = SIZE_MAX;
+        this->ended += 1;
+        return TraceFile::ENTRY_TYPE_NOP;
+    }
+
+    TraceFile::Entry entry = TraceFile::decode(&this->entries[position * 8]);
+    position += this->num_cpus;
+    *addr = entry.addr;
+    if (entry.type == TraceFile::ENTRY_TYPE_END) {
+        position = SIZE_MAX;
+        this->ended += 1;
+        return TraceFile::ENTRY_TYPE_NOP;
+    }
+    return entry.type;
+}
@@ -0,0 +1,56 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+
+#ifndef FRAMEWORK_TRACE_BUFFER_H
+#define FRAMEWORK_TRACE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "simulation.h"
+
+/*
+ * The trace as it is in the file, read into memory once: entry k of
+ * processor i is at k * num_cpus + i. TraceFile seeks for every entry,
+ * which costs more than the whole fast model.
+ * Processors may read their own entries from different threads.
+ */
+class TraceBuffer {
+public:
+    // `tracefile` is the one init_tracefile opened, its header is checked.
+    TraceBuffer(const char *tracefile, uint32_t num_cpus);
+
+    // A file already in memory, header included, like a mapping the
+    // workers of a sweep share. It is not copied and has to outlive the
+    // buffer.
+    TraceBuffer(const unsigned char *file, size_t size, uint32_t num_cpus);
+
+    // TraceFile::next: a NOP once the trace of `id` ended.
+    TraceFile::EntryType next(uint32_t id, uint64_t *addr);
+
+    // TraceFile::eof: the traces of all processors ended.
+    bool eof() const {
+        return this->ended == this->num_cpus;
+    }
+
+    bool ended_for(uint32_t id) const {
+        return this->positions[id] == SIZE_MAX;
+    }
+
+    // TraceFile::position, the entries read by `id`, and TraceFile::seek.
+    uint64_t position(uint32_t id) const;
+
+    void seek(uint32_t id, uint64_t position, bool finished);
+
+private:
+    uint32_t num_cpus;
+    std::vector<unsigned char> storage; // the entries, unless the file is mapped.
+    const unsigned char *entries;       // big endian, as in the file.
+    size_t count;
+    std::vector<size_t> positions; // SIZE_MAX once the processor reached its end.
+    std::atomic<uint32_t> ended;
+};
+
+#endif //FRAMEWORK_TRACE_BUFFER_H
@@ -6,6 +6,12 @@
 class bus_if : public virtual sc_interface {
     public:
     virtual int try_request(request_id) = 0;
+
+    // Cache `cpu_id` took the line of `addr`, or evicted it. The snoops of
+    // the line only visit the caches that have it.
+    virtual void add_sharer(uint32_t cpu_id, uint64_t addr) = 0;
+
+    virtual void remove_sharer(uint32_t cpu_id, uint64_t addr) = 0;
 };
 
 #endif
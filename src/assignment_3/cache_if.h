@@ -1,4 +1,5 @@
 #include <systemc.h>
+#include "ring_buffer.h"
 #include "types.h"
 
 #ifndef CPU_CACHE_IF_H
@@ -12,15 +13,20 @@ class cache_if : public virtual sc_interface {
 
     virtual int cpu_write(uint64_t addr) = 0;
 
-    virtual int send_new_event() = 0;
+    // A hit the processor served from a direct line, only its recency.
+    virtual void touch(uint64_t addr) = 0;
 
-    virtual int send_data(request) = 0;
+    // Called by the bus for every transaction it broadcasts.
+    virtual void snoop(const request &event) = 0;
+
+    virtual int send_data(const request &) = 0;
 
     virtual int ack() = 0;
 
     virtual int put_ack_from(location) = 0;
 
-    virtual std::vector<request> get_requests() = 0;
+    // The link to bus `bus_id`, the bus drains the requests in place.
+    virtual RingBuffer<request> &send_buffer(uint32_t bus_id) = 0;
 
     virtual bool get_cacheline_status(uint64_t, cache_status*) = 0;
 
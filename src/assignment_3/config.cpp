@@ -0,0 +1,301 @@
+//
+// Created by yanghoo on 3/4/24.
+//
+#include "config.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static const char *usage =
+        "options (after the tracefile):\n"
+        "  -q                  quiet, only print the statistics\n"
+        "  --arbiter <policy>  fcfs | rr | mem | age | wfs (default: mem)\n"
+        "  --age-limit <n>     cycles before a waiting request is starved (default: 64)\n"
+        "  --mem-weight <n>    memory grants per round for wfs (default: 4)\n"
+        "  --split-bus         split transaction bus with separate address/data buses\n"
+        "  --bus-width <n>     data bus width in bytes per cycle (default: 32)\n"
+        "  --outstanding <n>   transactions in the data phase at once (default: 4)\n"
+        "  --buses <n>         snooping buses, lines are interleaved over them (default: 1)\n"
+        "  --snoop-latency <n> cycles until a read knows if a cache has the line (default: 0)\n"
+        "  --spec-fetch        read memory while snooping, cancel on a cache hit\n"
+        "  --cache-supply      a cache that has the line supplies a read, not the memory\n"
+        "  --noc <topology>    ring | mesh network-on-chip instead of the bus\n"
+        "  --hop-latency <n>   cycles per router and link (default: 1)\n"
+        "  --link-bw <n>       flits per cycle per link (default: 1)\n"
+        "  --vcs <n>           virtual channels per port, 2 or more on a ring (default: 2)\n"
+        "  --vc-depth <n>      flits per virtual channel (default: 4)\n"
+        "  --mem-channels <n>  memory channels, a power of two (default: 1)\n"
+        "  --mem-banks <n>     banks per channel, a power of two (default: 1)\n"
+        "  --bank-busy <n>     cycles a bank is occupied per access (default: 1)\n"
+        "  --channel-width <n> channel data bus width in bytes per cycle (default: 32)\n"
+        "  --mem-map <map>     line | page | xor address interleaving (default: line)\n"
+        "  --write-queue <n>   posted writes per channel, reads go first (default: 0, off)\n"
+        "  --wq-high <n>       queued writes that start draining (default: 3/4 of the queue)\n"
+        "  --wq-low <n>        queued writes that stop draining (default: 1/4 of the queue)\n"
+        "  --merge-reads       reads of a line in flight share one memory access\n"
+        "  --dram              DRAM timing model with row buffers instead of the fixed latency\n"
+        "  --page <policy>     open | closed | adaptive row buffer policy (default: open)\n"
+        "  --dram-sched <s>    fcfs | frfcfs bank scheduling (default: frfcfs)\n"
+        "  --trcd, --tcas, --trp, --tras, --twr <n>\n"
+        "                      DRAM timings in cycles (default: 14, 14, 14, 32, 15)\n"
+        "  --twtr, --trtw <n>  write to read and read to write turnaround (default: 8, 4)\n"
+        "  --trefi, --trfc <n> refresh interval and duration, --trefi 0 disables refresh\n"
+        "                      (default: 7800, 350)\n"
+        "  --lt                loosely timed processors, hits run ahead of the clock\n"
+        "  --lt-quantum <n>    cycles a processor runs ahead at most (default: 100)\n"
+        "  --checkpoint <file> write the state after --checkpoint-at to file and stop\n"
+        "  --checkpoint-at <n> cycle the processors stop at for the checkpoint\n"
+        "  --restore <file>    continue from a checkpoint\n"
+        "  --warmup <n>[%]     run the first n entries (or percent) of every trace functionally\n"
+        "  --sample <n>        simulate one in n cache sets, estimate the miss rate (default: 1)\n"
+        "  --sample-validate   simulate every set, compare the estimate of --sample with it\n";
+
+static uint32_t parse_uint(const char *option, const char *value) {
+    char *end = nullptr;
+    unsigned long result = strtoul(value, &end, 10);
+    if (end == value || *end != '\0') {
+        throw runtime_error(string("Error, ") + option + " expects a number, got: " + value + "\n" + usage);
+    }
+    return (uint32_t) result;
+}
+
+static uint64_t parse_cycle(const char *option, const char *value) {
+    char *end = nullptr;
+    unsigned long long result = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+        throw runtime_error(string("Error, ") + option + " expects a number, got: " + value + "\n" + usage);
+    }
+    return (uint64_t) result;
+}
+
+static void parse_warmup(sim_config *config, const char *value) {
+    size_t length = strlen(value);
+    if (length > 1 && value[length - 1] == '%') {
+        string percent(value, length - 1);
+        config->warmup_percent = parse_uint("--warmup", percent.c_str());
+        if (config->warmup_percent == 0 || config->warmup_percent > 100) {
+            throw runtime_error(string("Error, --warmup expects a percentage up to 100%, got: ") + value + "\n"
+                                + usage);
+        }
+        return;
+    }
+    config->warmup_entries = parse_cycle("--warmup", value);
+}
+
+static arbiter_policy parse_arbiter(const char *value) {
+    if (!strcmp(value, "fcfs")) return arbiter_policy::fcfs;
+    if (!strcmp(value, "rr")) return arbiter_policy::round_robin;
+    if (!strcmp(value, "mem")) return arbiter_policy::memory_priority;
+    if (!strcmp(value, "age")) return arbiter_policy::age_based;
+    if (!strcmp(value, "wfs")) return arbiter_policy::weighted_fair;
+    throw runtime_error(string("Error, unknown arbiter: ") + value + "\n" + usage);
+}
+
+static enum interconnect parse_noc(const char *value) {
+    if (!strcmp(value, "ring")) return interconnect::ring_noc;
+    if (!strcmp(value, "mesh")) return interconnect::mesh_noc;
+    throw runtime_error(string("Error, unknown topology: ") + value + "\n" + usage);
+}
+
+static memory_mapping parse_mapping(const char *value) {
+    if (!strcmp(value, "line")) return memory_mapping::line_mapping;
+    if (!strcmp(value, "page")) return memory_mapping::page_mapping;
+    if (!strcmp(value, "xor")) return memory_mapping::xor_mapping;
+    throw runtime_error(string("Error, unknown memory mapping: ") + value + "\n" + usage);
+}
+
+static page_policy parse_page_policy(const char *value) {
+    if (!strcmp(value, "open")) return page_policy::open_page;
+    if (!strcmp(value, "closed")) return page_policy::closed_page;
+    if (!strcmp(value, "adaptive")) return page_policy::adaptive_page;
+    throw runtime_error(string("Error, unknown page policy: ") + value + "\n" + usage);
+}
+
+static dram_scheduler parse_dram_scheduler(const char *value) {
+    if (!strcmp(value, "fcfs")) return dram_scheduler::fcfs_order;
+    if (!strcmp(value, "frfcfs")) return dram_scheduler::frfcfs_order;
+    throw runtime_error(string("Error, unknown DRAM scheduler: ") + value + "\n" + usage);
+}
+
+static bool power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+sim_config parse_config(int argc, char *argv[]) {
+    sim_config config;
+
+    // argv[argc - 1] is the last argument, init_tracefile shifted argv by two
+    // but only decremented argc by one.
+    for (int i = 0; i < argc - 1; i++) {
+        const char *option = argv[i];
+        bool has_value = i + 1 < argc - 1;
+
+        if (!strcmp(option, "-q")) {
+            config.quiet = true;
+        } else if (!strcmp(option, "--arbiter") && has_value) {
+            config.arbiter = parse_arbiter(argv[++i]);
+        } else if (!strcmp(option, "--age-limit") && has_value) {
+            config.age_limit = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--mem-weight") && has_value) {
+            config.memory_weight = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--split-bus")) {
+            config.split_bus = true;
+        } else if (!strcmp(option, "--bus-width") && has_value) {
+            config.bus_width = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--outstanding") && has_value) {
+            config.max_outstanding = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--buses") && has_value) {
+            config.num_buses = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--snoop-latency") && has_value) {
+            config.snoop_latency = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--spec-fetch")) {
+            config.speculative_fetch = true;
+        } else if (!strcmp(option, "--cache-supply")) {
+            config.cache_supply = true;
+        } else if (!strcmp(option, "--noc") && has_value) {
+            config.interconnect = parse_noc(argv[++i]);
+        } else if (!strcmp(option, "--hop-latency") && has_value) {
+            config.hop_latency = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--link-bw") && has_value) {
+            config.link_bandwidth = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--vcs") && has_value) {
+            config.num_vcs = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--vc-depth") && has_value) {
+            config.vc_depth = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--mem-channels") && has_value) {
+            config.mem_channels = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--mem-banks") && has_value) {
+            config.mem_banks = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--bank-busy") && has_value) {
+            config.bank_busy = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--channel-width") && has_value) {
+            config.channel_width = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--mem-map") && has_value) {
+            config.mem_mapping = parse_mapping(argv[++i]);
+        } else if (!strcmp(option, "--write-queue") && has_value) {
+            config.write_queue = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--wq-high") && has_value) {
+            config.write_high = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--wq-low") && has_value) {
+            config.write_low = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--merge-reads")) {
+            config.merge_reads = true;
+        } else if (!strcmp(option, "--dram")) {
+            config.dram = true;
+        } else if (!strcmp(option, "--page") && has_value) {
+            config.page_policy = parse_page_policy(argv[++i]);
+        } else if (!strcmp(option, "--dram-sched") && has_value) {
+            config.dram_scheduler = parse_dram_scheduler(argv[++i]);
+        } else if (!strcmp(option, "--trcd") && has_value) {
+            config.dram_timing.t_rcd = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--tcas") && has_value) {
+            config.dram_timing.t_cas = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--trp") && has_value) {
+            config.dram_timing.t_rp = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--tras") && has_value) {
+            config.dram_timing.t_ras = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--twr") && has_value) {
+            config.dram_timing.t_wr = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--twtr") && has_value) {
+            config.dram_timing.t_wtr = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--trtw") && has_value) {
+            config.dram_timing.t_rtw = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--trefi") && has_value) {
+            config.dram_timing.t_refi = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--trfc") && has_value) {
+            config.dram_timing.t_rfc = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--lt")) {
+            config.loosely_timed = true;
+        } else if (!strcmp(option, "--lt-quantum") && has_value) {
+            config.lt_quantum = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--checkpoint") && has_value) {
+            config.checkpoint_file = argv[++i];
+        } else if (!strcmp(option, "--checkpoint-at") && has_value) {
+            config.checkpoint_at = parse_cycle(option, argv[++i]);
+        } else if (!strcmp(option, "--restore") && has_value) {
+            config.restore_file = argv[++i];
+        } else if (!strcmp(option, "--warmup") && has_value) {
+            parse_warmup(&config, argv[++i]);
+        } else if (!strcmp(option, "--sample") && has_value) {
+            config.sample_ratio = parse_uint(option, argv[++i]);
+        } else if (!strcmp(option, "--sample-validate")) {
+            config.sample_validate = true;
+        } else {
+            throw runtime_error(string("Error, unknown option: ") + option + "\n" + usage);
+        }
+    }
+
+    if (config.bus_width == 0 || config.max_outstanding == 0 || config.num_buses == 0) {
+        throw runtime_error(string("Error, --bus-width, --outstanding and --buses must be positive\n") + usage);
+    }
+    if (config.interconnect != interconnect::snooping_bus) {
+        if (config.num_buses != 1 || config.split_bus) {
+            throw runtime_error(string("Error, --noc replaces the bus, it excludes --buses and --split-bus\n") + usage);
+        }
+        if (config.hop_latency == 0 || config.link_bandwidth == 0 || config.num_vcs == 0 || config.vc_depth == 0) {
+            throw runtime_error(string("Error, the network parameters must be positive\n") + usage);
+        }
+        if (config.interconnect == interconnect::ring_noc && config.num_vcs < 2) {
+            // Without a channel class after the dateline the ring can deadlock.
+            throw runtime_error(string("Error, --noc ring needs --vcs 2 or more\n") + usage);
+        }
+    }
+    if (config.speculative_fetch && config.snoop_latency == 0) {
+        throw runtime_error(string("Error, --spec-fetch needs a positive --snoop-latency\n") + usage);
+    }
+    if (!power_of_two(config.mem_channels) || !power_of_two(config.mem_banks)) {
+        throw runtime_error(string("Error, --mem-channels and --mem-banks must be powers of two\n") + usage);
+    }
+    if (config.write_low == UINT32_MAX) {
+        config.write_low = config.write_queue / 4;
+    }
+    if (config.write_queue > 0) {
+        if (config.write_high == 0) {
+            config.write_high = max(1u, config.write_queue * 3 / 4);
+        }
+        if (config.write_high > config.write_queue || config.write_low >= config.write_high) {
+            throw runtime_error(string("Error, expected --wq-low < --wq-high <= --write-queue\n") + usage);
+        }
+    }
+    if (config.bank_busy == 0 || config.channel_width == 0) {
+        throw runtime_error(string("Error, --bank-busy and --channel-width must be positive\n") + usage);
+    }
+    if (config.lt_quantum == 0) {
+        throw runtime_error(string("Error, --lt-quantum must be positive\n") + usage);
+    }
+    if ((config.checkpoint_file == nullptr) != (config.checkpoint_at == 0)) {
+        throw runtime_error(string("Error, --checkpoint needs a positive --checkpoint-at and the other way round\n")
+                            + usage);
+    }
+    if (config.restore_file != nullptr && (config.warmup_entries > 0 || config.warmup_percent > 0)) {
+        throw runtime_error(string("Error, a restored simulation is warm already, --warmup excludes --restore\n")
+                            + usage);
+    }
+    if (config.sample_ratio == 0 || (config.sample_validate && config.sample_ratio == 1)) {
+        throw runtime_error(string("Error, --sample must be positive, --sample-validate needs one above 1\n") + usage);
+    }
+    if (config.sample_ratio > 1 && !config.sample_validate && config.checkpoint_file != nullptr) {
+        throw runtime_error(string("Error, the sets --sample skips would be missing in a checkpoint\n") + usage);
+    }
+    return config;
+}
+
+const char *arbiter_name(arbiter_policy policy) {
+    switch (policy) {
+        case fcfs:
+            return "fcfs";
+        case round_robin:
+            return "round robin";
+        case memory_priority:
+            return "memory priority";
+        case age_based:
+            return "age based";
+        case weighted_fair:
+            return "weighted fair share";
+    }
+    return "unknown";
+}
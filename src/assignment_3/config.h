@@ -0,0 +1,147 @@
+//
+// Created by yanghoo on 3/4/24.
+//
+
+#ifndef FRAMEWORK_CONFIG_H
+#define FRAMEWORK_CONFIG_H
+
+#include <cstdint>
+
+enum arbiter_policy {
+    fcfs = 0,            // oldest request first, regardless of the source.
+    round_robin = 1,     // rotate over the caches, memory is one more requester.
+    memory_priority = 2, // memory responses first, then the oldest cache request.
+    age_based = 3,       // memory priority until a cache request gets too old.
+    weighted_fair = 4,   // deficit round robin with per-requester weights.
+};
+
+enum interconnect {
+    snooping_bus = 0, // one or more shared buses.
+    ring_noc = 1,     // bidirectional ring network-on-chip.
+    mesh_noc = 2,     // 2D mesh network-on-chip with XY routing.
+};
+
+enum memory_mapping {
+    line_mapping = 0, // consecutive lines over the channels, then the banks.
+    page_mapping = 1, // consecutive rows over the channels, then the banks.
+    xor_mapping = 2,  // page mapping, permuted with the upper row bits.
+};
+
+enum page_policy {
+    open_page = 0,     // the row stays open until another row is needed.
+    closed_page = 1,   // precharge after every access.
+    adaptive_page = 2, // keep the row open while the bank queue has a hit for it.
+};
+
+enum dram_scheduler {
+    fcfs_order = 0,   // every bank serves its queue in arrival order.
+    frfcfs_order = 1, // row hits first, then the oldest request.
+};
+
+// DRAM timing parameters in cycles.
+typedef struct dram_timing {
+    uint32_t t_rcd = 14;   // activate to column command.
+    uint32_t t_cas = 14;   // column command to data.
+    uint32_t t_rp = 14;    // precharge to activate.
+    uint32_t t_ras = 32;   // activate to precharge.
+    uint32_t t_wr = 15;    // end of write data to precharge.
+    uint32_t t_wtr = 8;    // write to read turnaround on the data bus.
+    uint32_t t_rtw = 4;    // read to write turnaround on the data bus.
+    uint32_t t_refi = 7800; // refresh interval, 0 disables refresh.
+    uint32_t t_rfc = 350;  // refresh cycle time.
+} dram_timing;
+
+/*
+ * Simulation parameters, parsed from the arguments after the tracefile.
+ * Defaults give the model described in report.md.
+ */
+typedef struct sim_config {
+    bool quiet = false;
+
+    arbiter_policy arbiter = arbiter_policy::memory_priority;
+    // A request waiting longer than this (cycles) counts as starved,
+    // the age based arbiter promotes it.
+    uint32_t age_limit = 64;
+    // Grants per round for the memory in the weighted fair share arbiter,
+    // every cache has a weight of 1.
+    uint32_t memory_weight = 4;
+
+    // Split transaction bus: separate address and data buses, a cache line
+    // takes BLOCK_SIZE / bus_width data cycles and at most max_outstanding
+    // transactions wait for or occupy the data bus.
+    bool split_bus = false;
+    uint32_t bus_width = 32;
+    uint32_t max_outstanding = 4;
+
+    // Independent snooping buses, cache lines are interleaved over them.
+    uint32_t num_buses = 1;
+
+    // Cycles until a read knows whether a cache has the line. With
+    // speculative_fetch the memory read starts with the snoop and is
+    // cancelled when a cache supplies the line.
+    uint32_t snoop_latency = 0;
+    bool speculative_fetch = false;
+    // A cache that has the line supplies it, instead of the memory. Holds
+    // with or without snoop_latency.
+    bool cache_supply = false;
+
+    // Network-on-chip instead of the bus, see Noc.h.
+    enum interconnect interconnect = interconnect::snooping_bus;
+    uint32_t hop_latency = 1;    // cycles per router and link.
+    uint32_t link_bandwidth = 1; // flits per cycle.
+    uint32_t num_vcs = 2;        // virtual channels per port.
+    uint32_t vc_depth = 4;       // flits per virtual channel.
+
+    // Memory channels and banks, see MemoryController.h. With one cycle per
+    // bank access the memory is fully pipelined.
+    uint32_t mem_channels = 1;
+    uint32_t mem_banks = 1; // per channel.
+    uint32_t bank_busy = 1;
+    uint32_t channel_width = 32; // bytes per cycle.
+    enum memory_mapping mem_mapping = memory_mapping::line_mapping;
+    // Posted writes per channel, 0 keeps reads and writes in one queue.
+    uint32_t write_queue = 0;
+    uint32_t write_high = 0; // 0 picks 3/4 of the write queue.
+    uint32_t write_low = UINT32_MAX; // not given, picks 1/4 of the write queue.
+    // Reads of a line that memory is already reading wait for that response.
+    bool merge_reads = false;
+
+    // DRAM timing model instead of the fixed latency, see DramController.h.
+    bool dram = false;
+    struct dram_timing dram_timing;
+    enum page_policy page_policy = page_policy::open_page;
+    enum dram_scheduler dram_scheduler = dram_scheduler::frfcfs_order;
+
+    // Loosely timed processors: they run ahead of the clock on cache hits
+    // by up to lt_quantum cycles, see CPU.h.
+    bool loosely_timed = false;
+    uint32_t lt_quantum = 100;
+
+    // Checkpoints, see Checkpoint.h. The state once the machine drained
+    // after checkpoint_at is written to checkpoint_file and the simulation
+    // stops, a simulation with restore_file continues from it.
+    const char *checkpoint_file = nullptr;
+    uint64_t checkpoint_at = 0;
+    const char *restore_file = nullptr;
+
+    // Functional warm-up of the first warmup_entries entries, or the first
+    // warmup_percent of the trace, of every processor, see
+    // FunctionalWarmup.h.
+    uint64_t warmup_entries = 0;
+    uint32_t warmup_percent = 0;
+
+    // Set sampling, one in sample_ratio sets is simulated, see sample_init
+    // in psa.h. 1 simulates every set.
+    uint32_t sample_ratio = 1;
+    bool sample_validate = false;
+} sim_config;
+
+/*
+ * Parses the remaining arguments (init_tracefile already took the tracefile
+ * out of argv). Throws runtime_error on unknown options.
+ */
+sim_config parse_config(int argc, char *argv[]);
+
+const char *arbiter_name(arbiter_policy policy);
+
+#endif //FRAMEWORK_CONFIG_H
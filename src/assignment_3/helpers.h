@@ -4,18 +4,37 @@
 #include <iomanip>
 #include <iostream>
 #include <systemc.h>
+#include "types.h"
 
 const int t_width = 7;
 const int n_width = 7;
 
 using namespace std;
 
+// The enums are traced as the bytes they are stored in.
+inline void sc_trace(sc_trace_file*& f, const request& val, const std::string& name) {
+    sc_trace(f, val.addr, name + ".addr");
+    sc_trace(f, reinterpret_cast<const uint8_t &>(val.op), name + ".op");
+    sc_trace(f, reinterpret_cast<const uint8_t &>(val.source), name + ".source");
+    sc_trace(f, reinterpret_cast<const uint8_t &>(val.destination), name + ".destination");
+}
+
+inline void sc_trace(sc_trace_file*& f, const request_id& val, const std::string& name) {
+    sc_trace(f, val.cpu_id, name + ".cpu");
+    sc_trace(f, reinterpret_cast<const uint8_t &>(val.source), name + ".source");
+}
+
+/* The length of `n` cycles, the clock of top.cpp has the default period. */
+inline sc_time cycles(uint64_t n) {
+    return sc_time((double) n, SC_NS);
+}
+
 inline void log_rest() {
     cout << endl;
 }
 
 template <typename T, typename... Tail>
-void log_rest(const char *n1, T v1, Tail... tail) {
+void log_rest(const char *n1, const T &v1, const Tail &... tail) {
     // log head
     cout << ": " << n1 << ": " << v1;
     log_rest(tail...);
@@ -23,14 +42,14 @@ void log_rest(const char *n1, T v1, Tail... tail) {
 
 /* Log a simple message. */
 inline void log(const char *comp, const char *msg) {
-    if (sc_report_handler::get_verbosity_level() >= SC_MEDIUM) {
+    if (debug_log) {
         cout << setw(t_width) << sc_time_stamp() << ": " << setw(n_width) << comp;
         cout << ": " << msg << endl;
     }
 }
 
-inline void log_addr(const char *comp, const string& msg, uint64_t addr) {
-    if (sc_report_handler::get_verbosity_level() >= SC_MEDIUM) {
+inline void log_addr(const char *comp, const char *msg, uint64_t addr) {
+    if (debug_log) {
         cout << setw(t_width) << sc_time_stamp() << ": " << comp;
         cout << ": " << msg << " on 0x" << setfill('0') << setw(16) << right << hex << addr << endl;
     }
@@ -38,10 +57,11 @@ inline void log_addr(const char *comp, const string& msg, uint64_t addr) {
 
 /* Log the state change of a component to std out.
  * First argument is the name of component, followed by pairs
- * of name, values that need to be printed. */
+ * of name, values that need to be printed. Nothing is built or
+ * printed unless debug_log is on, the values are streamed as they are. */
 template <typename T, typename... Tail>
-void log(const char *comp, const char *n1, T v1, Tail... tail) {
-    if (sc_report_handler::get_verbosity_level() >= SC_MEDIUM) {
+void log(const char *comp, const char *n1, const T &v1, const Tail &... tail) {
+    if (debug_log) {
         // timestamp and name
         cout << setw(t_width) << sc_time_stamp() << ": " << setw(n_width) << comp;
         // log head
@@ -3,7 +3,7 @@
 //
 #include "lru.h"
 #include <iostream>
-#include "psa.h"
+#include "simulation.h"
 
 using namespace std;
 
@@ -4,18 +4,17 @@
 #ifndef FRAMEWORK_LRU_H
 #define FRAMEWORK_LRU_H
 
-#include <systemc.h>
+#include <cstdint>
 #include <string>
 #include <iomanip>
 #include <iostream>
+#include "cache_size.h"
 #include "types.h"
 
 using namespace std;
 
-static const size_t BLOCK_SIZE = 32; // 32 Bytes.
-static const size_t SET_SIZE = 8; // 8-Set associative cache.
-
-using namespace sc_core;
+static const size_t BLOCK_SIZE = LINE_SIZE; // 32 Bytes.
+static const size_t SET_SIZE = CACHE_WAYS; // 8-Set associative cache.
 
 struct LRUnit {
     uint8_t index;
@@ -81,8 +80,10 @@ public:
 
     void invalid(LRUnit* curr) {
         if (curr == nullptr) return;
-        cout << "[invalid_size_start]: " << to_string(this->size);
-        cout << " " << curr->tag;
+        if (debug_log) {
+            cout << "[invalid_size_start]: " << (unsigned) this->size;
+            cout << " " << curr->tag;
+        }
 
         curr->status = cache_status::invalid;
         curr->has_data = false;
@@ -112,23 +113,24 @@ public:
             }
         }
 
-        cout << " [invalid_size_end]: " << to_string(this->size) << endl;
+        if (debug_log) {
+            cout << " [invalid_size_end]: " << (unsigned) this->size << endl;
+        }
         // disconnect the adjacent nodes.
         curr->prev = nullptr;
         curr->next = nullptr;
     };
 
     LRUnit *find(uint64_t tag) const {
-        LRUnit *curr = this->head;
-
-        while (curr != nullptr) {
-            if (curr->tag == tag) {
+        // Scan the array rather than walk the list, the loads don't wait on
+        // each other. A line is in the list if it is the head or has a prev.
+        for (uint8_t i = 0; i < this->capacity; i++) {
+            LRUnit *curr = &this->lines[i];
+            if (curr->tag == tag && (curr->prev != nullptr || curr == this->head)) {
                 return curr;
-            } else {
-                curr = curr->next;
             }
         }
-        return curr;
+        return nullptr;
     }
 
     bool is_empty() const {
@@ -141,7 +143,9 @@ public:
 
     LRUnit* get_clean_node() const {
         for (uint8_t i = 0; i < this->capacity; i++) {
-            cout << "status : " << to_string(this->lines[i].status) << endl;
+            if (debug_log) {
+                cout << "status : " << (int) this->lines[i].status << endl;
+            }
             if (this->lines[i].status == cache_status::invalid) {
                 return &this->lines[i];
             }
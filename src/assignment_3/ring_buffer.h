@@ -0,0 +1,108 @@
+//
+// Created by yanghoo on 3/4/24.
+//
+
+#ifndef FRAMEWORK_RING_BUFFER_H
+#define FRAMEWORK_RING_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * FIFO backed by a power-of-two array. push/pop/front are O(1) and never
+ * allocate, the owner decides when a full buffer is worth a grow().
+ */
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 8) {
+        size_t slots = 1;
+        while (slots < capacity) {
+            slots <<= 1;
+        }
+        this->slots = std::vector<T>(slots);
+        this->mask = slots - 1;
+    }
+
+    bool push(const T &item) {
+        if (this->full()) {
+            return false;
+        }
+        this->slots[this->tail & this->mask] = item;
+        this->tail += 1;
+        return true;
+    }
+
+    void pop() {
+        if (!this->empty()) {
+            this->head += 1;
+        }
+    }
+
+    T &front() {
+        return this->slots[this->head & this->mask];
+    }
+
+    const T &front() const {
+        return this->slots[this->head & this->mask];
+    }
+
+    // i-th element counted from the front.
+    T &operator[](size_t i) {
+        return this->slots[(this->head + i) & this->mask];
+    }
+
+    const T &operator[](size_t i) const {
+        return this->slots[(this->head + i) & this->mask];
+    }
+
+    size_t size() const {
+        return this->tail - this->head;
+    }
+
+    size_t capacity() const {
+        return this->mask + 1;
+    }
+
+    bool empty() const {
+        return this->head == this->tail;
+    }
+
+    bool full() const {
+        return this->size() == this->capacity();
+    }
+
+    void clear() {
+        this->head = this->tail;
+    }
+
+    // Removes the i-th element, the ones behind it move up.
+    void erase(size_t i) {
+        for (size_t j = i; j + 1 < this->size(); j++) {
+            (*this)[j] = (*this)[j + 1];
+        }
+        this->tail -= 1;
+    }
+
+    // Doubles the capacity, keeping the order of the elements.
+    void grow() {
+        std::vector<T> larger(this->capacity() * 2);
+        size_t count = this->size();
+        for (size_t i = 0; i < count; i++) {
+            larger[i] = (*this)[i];
+        }
+        this->slots.swap(larger);
+        this->mask = this->slots.size() - 1;
+        this->head = 0;
+        this->tail = count;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    // Monotonic counters, the slot index is counter & mask.
+    size_t head = 0;
+    size_t tail = 0;
+};
+
+#endif //FRAMEWORK_RING_BUFFER_H
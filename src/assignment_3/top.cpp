@@ -8,79 +8,179 @@
 
 #include "Manager.h"
 #include "Cache.h"
+#include "Checkpoint.h"
+#include "FunctionalWarmup.h"
 #include "CPU.h"
 #include "psa.h"
 #include "Bus.h"
+#include "Noc.h"
 #include "Memory.h"
+#include "config.h"
 
 using namespace std;
 
+// Puts the caches, trace positions and statistics of a checkpoint in place,
+// the buses learn which caches have a line.
+static void restore(SimulationContext &context, const checkpoint &state, const vector<Cache *> &caches,
+                    const vector<Bus *> &buses) {
+    if (state.processors.size() != context.num_cpus) {
+        throw runtime_error("Error, the checkpoint is of a trace with another number of processors\n");
+    }
+    for (uint32_t i = 0; i < context.num_cpus; i++) {
+        const checkpoint::processor &p = state.processors[i];
+        caches[i]->restore(p);
+        for (size_t set = 0; set < p.sets.size(); set++) {
+            for (const auto &line : p.sets[set]) {
+                uint64_t addr = (line.tag * NR_SETS + set) << 5;
+                buses[line_interleave(addr, (uint32_t) buses.size())]->add_sharer(i, addr);
+            }
+        }
+        context.tracefile->seek(i, p.position, p.ended);
+        context.stats_restore(i, p.stats);
+    }
+}
+
+static void write_checkpoint(const SimulationContext &context, const sim_config &config, const Manager &dispatcher,
+                             const vector<Cache *> &caches) {
+    if (!dispatcher.drained()) {
+        throw runtime_error("Error, the trace ended before cycle " + to_string(config.checkpoint_at)
+                            + ", no checkpoint was written\n");
+    }
+    checkpoint state;
+    state.cycle = dispatcher.drained_at();
+    state.processors = vector<checkpoint::processor>(context.num_cpus);
+    for (uint32_t i = 0; i < context.num_cpus; i++) {
+        checkpoint::processor &p = state.processors[i];
+        p.position = context.tracefile->position(i);
+        p.ended = context.tracefile->ended(i);
+        p.stats = context.stats_save(i);
+        caches[i]->save(p);
+    }
+    save_checkpoint(config.checkpoint_file, state);
+    cerr << "Checkpoint of cycle " << state.cycle << " written to " << config.checkpoint_file << endl;
+}
+
 int sc_main(int argc, char *argv[]) {
     try {
+        const char *tracefile = argc > 1 ? argv[1] : nullptr;
         // Get the tracefile argument and create Tracefile object
-        // This function sets tracefile_ptr and num_cpus
-        init_tracefile(&argc, &argv);
+        // This function sets the trace and num_cpus of the context, every
+        // module of the simulation gets it.
+        SimulationContext context;
+        init_tracefile(context, &argc, &argv);
 
         // init_tracefile changed argc and argv so we cannot use
         // getopt anymore.
-        // The "-q" flag must be specified _after_ the tracefile.
-        if (argc == 2 && !strcmp(argv[0], "-q")) {
+        // The options must be specified _after_ the tracefile.
+        sim_config config = parse_config(argc, argv);
+        debug_log = !config.quiet;
+        if (config.quiet) {
             sc_report_handler::set_verbosity_level(SC_LOW);
         }
 
         sc_set_time_resolution(1, SC_PS);
 
         // Initialize statistics counters
-        stats_init();
+        context.stats_init();
+        if (config.sample_ratio > 1) {
+            context.sample_init(NR_SETS, config.sample_ratio, config.sample_validate);
+        }
+
+        // Loosely timed processors run ahead of the clock by up to a quantum.
+        if (config.loosely_timed) {
+            tlm::tlm_global_quantum::instance().set(cycles(config.lt_quantum));
+        }
+
+        // A restored simulation starts at the cycle of its checkpoint, a
+        // functional warm-up hands over warm caches at cycle 0.
+        checkpoint restored;
+        restored.cycle = 0;
+        bool warm_up = config.warmup_entries > 0 || config.warmup_percent > 0;
+        if (config.restore_file != nullptr) {
+            restored = load_checkpoint(config.restore_file);
+        } else if (warm_up) {
+            restored = FunctionalWarmup::warm_up(config, tracefile, context.num_cpus, NR_SETS);
+        }
 
         // Create instances with id 0
         // The clock that will drive the Manager and bus.
-        sc_clock clk;
+        sc_clock clk(sc_gen_unique_name("clock"), cycles(1), 0.5, cycles(restored.cycle), true);
 
-        auto memory = new Memory("memory");
-        auto bus = new Bus("Bus");
-        auto dispatcher = new Manager(sc_gen_unique_name("manager"));
+        auto memory = new Memory("memory", context, config);
+        auto dispatcher = new Manager(sc_gen_unique_name("manager"), context, config.checkpoint_at);
 
-        sc_buffer<request> request_buffer;
+        // Cache lines are interleaved over the buses, every bus has its own
+        // arbiter and memory port.
+        vector<Bus *> buses;
+        vector<Cache *> caches;
         sc_signal<bool> start_signal;
 
         memory->clk(clk);
-        memory->bus(*bus);
         dispatcher->clock(clk);
-
-        bus->clock(clk);
-        bus->memory(*memory);
-        bus->CachePort(request_buffer);
         dispatcher->start(start_signal);
+
+        for (uint32_t i = 0; i < config.num_buses; i++) {
+            Bus *bus;
+            if (config.interconnect == interconnect::snooping_bus) {
+                bus = new Bus(sc_gen_unique_name("bus"), context, config, i);
+            } else {
+                bus = new Noc(sc_gen_unique_name("noc"), context, config);
+            }
+            memory->bus(*bus);
+            bus->clock(clk);
+            bus->memory(*memory);
+            buses.push_back(bus);
+        }
         /*
         * bus and cache should connects to the Manager.
         * list: Manager <-> Cache <-> bus <-> Memory
-        * Every cache also has a signal port.
+        * Every bus snoops the caches through their cache_if, one port
+        * bound once per cache.
         */
-        for (uint32_t i = 0; i < num_cpus; i++) {
-            auto cache = new Cache(sc_gen_unique_name("cache"), (int) i);
-
-            cache->bus_port(*bus);
-            cache->Port_Cache(request_buffer);
+        for (uint32_t i = 0; i < context.num_cpus; i++) {
+            auto cache = new Cache(sc_gen_unique_name("cache"), context, (int) i, config.num_buses);
+            caches.push_back(cache);
+
+            for (uint32_t j = 0; j < config.num_buses; j++) {
+                cache->bus_port(*buses[j]);
+                buses[j]->caches(*cache);
+            }
             cache->clk(clk);
-            bus->caches[i](*cache);
 
-            auto cpu = new CPU(sc_gen_unique_name("cpu"), (int) i);
+            auto cpu = new CPU(sc_gen_unique_name("cpu"), context, (int) i, config.loosely_timed);
             cpu->start(start_signal);
             cpu->clock(clk);
             cpu->manager(*dispatcher);
             cpu->cache(*cache);
+            cpu->socket.bind(cache->socket);
+        }
+
+        if (config.restore_file != nullptr || warm_up) {
+            restore(context, restored, caches, buses);
         }
 
         // Start Simulation
         sc_start();
 
         // Print statistics after simulation finished
-        stats_print();
+        context.stats_print(cout);
+        for (auto bus : buses) {
+            bus->print_stats();
+        }
+        memory->print_stats();
         cout << sc_time_stamp() << endl;
+        if (config.sample_ratio > 1) {
+            context.sample_print(cout);
+        }
+
+        if (config.checkpoint_file != nullptr) {
+            write_checkpoint(context, config, *dispatcher, caches);
+        }
 
         // Cleanup components
-        delete bus;
+        for (auto bus : buses) {
+            delete bus;
+        }
         delete memory;
         delete dispatcher;
     } catch (exception &e) {
@@ -4,18 +4,20 @@
 #include "types.h"
 using namespace::std;
 
+bool debug_log = false;
+
 std::ostream& operator<<(std::ostream& os, const request& val) {
     os << "sender: " << to_string(val.sender_id) <<  std::endl;
     os << "receiver: " << to_string(val.receiver_id) <<  std::endl;
     os << "addr: " << val.addr<<  std::endl;
-    os << "source: " << val.source <<  std::endl;
-    os << "destination: " << val.destination <<  std::endl;
-    os << "op: " << val.op <<  std::endl;
+    os << "source: " << (int) val.source <<  std::endl;
+    os << "destination: " << (int) val.destination <<  std::endl;
+    os << "op: " << (int) val.op <<  std::endl;
     return os;
 }
 
 std::ostream& operator<<(std::ostream& os, const request_id& val) {
     os << "cpu: " << to_string(val.cpu_id) <<  std::endl;
-    os << "source: " << val.source <<  std::endl;
+    os << "source: " << (int) val.source <<  std::endl;
     return os;
 }
\ No newline at end of file
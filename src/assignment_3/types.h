@@ -4,24 +4,36 @@
 
 #ifndef FRAMEWORK_TYPES_H
 #define FRAMEWORK_TYPES_H
-#include <systemc.h>
+#include <cstdint>
+#include <ostream>
 
-enum location {
+// Whether the models print their debug lines on cout, off unless the
+// simulator turns it on. sc_main does without -q.
+extern bool debug_log;
+
+// The enums of a message are one byte each, see request.
+enum location : uint8_t {
     // source type
     memory = 0,
     cache = 1,
     all = 2,
 };
 
-enum op_type {
+enum op_type : uint8_t {
     probe_read = 0,
     probe_write = 1,
     data_transfer = 2,
 };
 
+// Processors a request can address, its ids are 16 bits.
+static const uint32_t MAX_CPUS = 1 << 16;
+
+// The message between caches, buses and memory, 16 bytes: the ids and
+// enums share the first word with the address in the second. It is
+// passed by reference and sits in the ring buffers of the links.
 typedef struct request {
-    uint8_t sender_id; // cpu no.
-    uint8_t receiver_id;
+    uint16_t sender_id; // cpu no.
+    uint16_t receiver_id;
     enum location source;
     enum location destination;
     enum op_type op;
@@ -39,17 +51,12 @@ typedef struct request {
     }
 } request;
 
-std::ostream& operator<<(std::ostream& os, const request& val);
+static_assert(sizeof(request) == 16, "a request is two words");
 
-inline void sc_trace(sc_trace_file*& f, const request& val, const std::string& name) {
-    sc_trace(f, val.addr, name + ".addr");
-    sc_trace(f, val.op, name + ".op");
-    sc_trace(f, val.source, name + ".source");
-    sc_trace(f, val.destination, name + ".destination");
-}
+std::ostream& operator<<(std::ostream& os, const request& val);
 
 typedef struct request_id {
-    uint8_t cpu_id; // cpu no.
+    uint16_t cpu_id; // cpu no.
     enum location source;
 
     request_id& operator=(const request_id& rhs) {
@@ -65,9 +72,15 @@ typedef struct request_id {
 
 std::ostream& operator<<(std::ostream& os, const request_id& val);
 
-inline void sc_trace(sc_trace_file*& f, const request_id& val, const std::string& name) {
-    sc_trace(f, val.cpu_id, name + ".cpu");
-    sc_trace(f, val.source, name + ".source");
+/*
+ * Spreads cache lines over `ways` units (buses, memory ports). The line
+ * number is folded before the modulo so strided accesses do not all end up
+ * on the same unit.
+ */
+inline uint32_t line_interleave(uint64_t addr, uint32_t ways) {
+    uint64_t line = addr >> 5;
+    line ^= (line >> 7) ^ (line >> 17);
+    return (uint32_t) (line % ways);
 }
 
 enum cache_status {
@@ -78,6 +91,24 @@ enum cache_status {
     owned = 4
 };
 
-typedef std::vector<request_id> bus_requests;
+/*
+ * The MOESI state a line moves to in a cache that snoops another cache's
+ * transaction on it: a read makes an exclusive line shared and a modified
+ * one owned, a write invalidates it. The callers drop an invalid line
+ * from their own bookkeeping.
+ */
+inline cache_status snooped(cache_status status, bool write) {
+    if (write) {
+        return cache_status::invalid;
+    }
+    switch (status) {
+        case cache_status::exclusive:
+            return cache_status::shared;
+        case cache_status::modified:
+            return cache_status::owned;
+        default:
+            return status;
+    }
+}
 
 #endif //FRAMEWORK_TYPES_H
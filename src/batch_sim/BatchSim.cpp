@@ -0,0 +1,126 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+#include "BatchSim.h"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "simulation.h"
+
+using namespace std;
+
+// Rows of the trace read at once, a row is one entry of every processor.
+static const size_t ROWS_PER_READ = 4096;
+
+BatchSim::BatchSim(const vector<cache_config> &configs) {
+    size_t first = 0;
+    for (const auto &config : configs) {
+        if (config.ways == 0 || config.size % (config.ways * LINE_SIZE) != 0) {
+            throw runtime_error("Error, a cache of " + to_string(config.size) + " bytes has no whole sets of "
+                                + to_string(config.ways) + " ways\n");
+        }
+        size_t sets = config.size / (config.ways * LINE_SIZE);
+        this->lanes.push_back(lane{config, sets, first, 0, 0, 0, 0});
+        first += sets * config.ways;
+    }
+    this->lines = vector<uint64_t>(first, 0);
+}
+
+uint64_t BatchSim::run(const char *tracefile, uint32_t num_cpus, uint32_t cpuid) {
+    FILE *file = fopen(tracefile, "rb");
+    if (file == nullptr || fseek(file, 8, SEEK_SET) != 0) {
+        throw runtime_error(string("Unable to open file: ") + tracefile);
+    }
+
+    size_t row_size = num_cpus * 8;
+    vector<unsigned char> buffer(ROWS_PER_READ * row_size);
+    vector<uint64_t> accesses(ROWS_PER_READ);
+    uint64_t entries = 0;
+    bool ended = false;
+    while (!ended) {
+        size_t bytes = fread(buffer.data(), 1, buffer.size(), file);
+        // A partial entry at the end is not read, like in TraceFile.
+        size_t rows = bytes / row_size + (bytes % row_size >= cpuid * 8 + 8 ? 1 : 0);
+        // No end tag, the trace stops with the file.
+        ended = bytes < buffer.size();
+
+        size_t count = 0;
+        for (size_t row = 0; row < rows; row++) {
+            TraceFile::Entry entry = TraceFile::decode(&buffer[row * row_size + cpuid * 8]);
+            entries++;
+            uint64_t line = entry.addr / LINE_SIZE;
+            switch (entry.type) {
+                case TraceFile::ENTRY_TYPE_READ:
+                    accesses[count++] = line << 1;
+                    break;
+                case TraceFile::ENTRY_TYPE_WRITE:
+                    accesses[count++] = line << 1 | 1;
+                    break;
+                case TraceFile::ENTRY_TYPE_END:
+                    ended = true;
+                    rows = row;
+                    break;
+                default:
+                    break;
+            }
+        }
+        // Every configuration in turn over the same chunk.
+        for (auto &l : this->lanes) {
+            this->simulate(l, accesses.data(), count);
+        }
+    }
+    fclose(file);
+    return entries;
+}
+
+void BatchSim::simulate(lane &l, const uint64_t *accesses, size_t count) {
+    size_t ways = l.config.ways;
+    bool reorder = l.config.replacement == replacement::lru;
+    uint64_t *lines = &this->lines[l.first];
+    // A mask instead of the division for a power of two sets.
+    uint64_t mask = (l.sets & (l.sets - 1)) == 0 ? l.sets - 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t line = accesses[i] >> 1;
+        bool write = accesses[i] & 1;
+        uint64_t *set = &lines[(mask != 0 || l.sets == 1 ? line & mask : line % l.sets) * ways];
+
+        // Its way, or the last one when it is not there.
+        size_t d = 0;
+        while (d < ways - 1 && set[d] != line + 1) {
+            d++;
+        }
+        bool hit = set[d] == line + 1;
+        if (write) {
+            (hit ? l.writehit : l.writemiss)++;
+        } else {
+            (hit ? l.readhit : l.readmiss)++;
+        }
+        // A miss fills the first way and evicts the last one.
+        if (hit && !reorder) {
+            continue;
+        }
+        for (; d > 0; d--) {
+            set[d] = set[d - 1];
+        }
+        set[0] = line + 1;
+    }
+}
+
+void BatchSim::print_stats(ostream &out) const {
+    out << "Config\t\tReads\tRHit\tRMiss\tWrites\tWHit\tWMiss\tHitrate\n";
+    for (const auto &l : this->lanes) {
+        uint64_t reads = l.readhit + l.readmiss;
+        uint64_t writes = l.writehit + l.writemiss;
+        // Ratio of hits to the number of total accesses, as a percentage.
+        double hitrate = 100 * (double) (l.readhit + l.writehit) / (double) (reads + writes);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%s/%lu/%s\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t%f\n",
+                 size_name(l.config.size).c_str(), (unsigned long) l.config.ways,
+                 l.config.replacement == replacement::lru ? "lru" : "fifo", (unsigned long) reads,
+                 (unsigned long) l.readhit, (unsigned long) l.readmiss, (unsigned long) writes,
+                 (unsigned long) l.writehit, (unsigned long) l.writemiss, hitrate);
+        out << line;
+    }
+}
@@ -0,0 +1,66 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+
+#ifndef FRAMEWORK_BATCH_SIM_H
+#define FRAMEWORK_BATCH_SIM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "cache_size.h"
+
+enum replacement {
+    lru = 0,  // the least recently used line, like assignment_1.
+    fifo = 1, // the line filled first, hits do not reorder the set.
+};
+
+/*
+ * Many cache configurations of assignment_1 on one pass over the trace of
+ * a processor. The trace is read and decoded once, in chunks, and every
+ * configuration runs over a chunk before the next one is read, so the
+ * state of a configuration stays in the host caches while it runs.
+ * A configuration has the hits and misses of assignment_1 with that cache.
+ */
+class BatchSim {
+public:
+    typedef struct cache_config {
+        size_t size; // bytes.
+        size_t ways;
+        enum replacement replacement;
+    } cache_config;
+
+    // Throws runtime_error for a cache without a whole set.
+    explicit BatchSim(const std::vector<cache_config> &configs);
+
+    // Runs the trace of `cpuid`, until its end tag or the end of the file.
+    // Returns the entries read.
+    uint64_t run(const char *tracefile, uint32_t num_cpus, uint32_t cpuid);
+
+    // The statistic counters of every configuration, like stats_print.
+    void print_stats(std::ostream &out) const;
+
+private:
+    // The state of one configuration: its sets in `lines` from `first` on,
+    // `ways` lines each, most recently used (or filled) first. A line is
+    // stored + 1, 0 is a free way.
+    typedef struct lane {
+        cache_config config;
+        size_t sets;
+        size_t first;
+        uint64_t readhit;
+        uint64_t readmiss;
+        uint64_t writehit;
+        uint64_t writemiss;
+    } lane;
+
+    std::vector<lane> lanes;
+    std::vector<uint64_t> lines;
+
+    // `accesses` are the line << 1, with the write bit below.
+    void simulate(lane &l, const uint64_t *accesses, size_t count);
+};
+
+#endif //FRAMEWORK_BATCH_SIM_H
@@ -0,0 +1,122 @@
+/*
+// File: main.cpp
+//
+// The caches of assignment_1 in many configurations, from one pass over
+// the trace.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BatchSim.h"
+#include "simulation.h"
+
+using namespace std;
+
+static const char *usage =
+        "usage: batch_sim.bin <tracefile> [options]\n"
+        "  --config <size>[K|M]:<ways>[:lru|fifo]\n"
+        "                      a cache to simulate, repeated for every configuration\n"
+        "                      (default: 32K:8:lru, the cache of assignment_1)\n"
+        "  --cpu <id>          the processor whose trace runs (default: 0, like assignment_1)\n"
+        "  --serial            one pass per configuration, to compare the host time with\n";
+
+static uint64_t parse_number(const char *option, const char *value, char **end) {
+    unsigned long long number = strtoull(value, end, 10);
+    if (*end == value) {
+        throw runtime_error(string("Error, ") + option + " expects a number, got: " + value + "\n" + usage);
+    }
+    return number;
+}
+
+static BatchSim::cache_config parse_cache(const char *value) {
+    BatchSim::cache_config config{0, 0, replacement::lru};
+    char *end;
+    config.size = (size_t) parse_number("--config", value, &end);
+    if (*end == 'K' || *end == 'M') {
+        config.size <<= *end == 'K' ? 10 : 20;
+        end++;
+    }
+    if (*end == ':') {
+        config.ways = (size_t) parse_number("--config", end + 1, &end);
+    }
+    if (!strcmp(end, ":fifo")) {
+        config.replacement = replacement::fifo;
+    } else if (*end != '\0' && strcmp(end, ":lru") != 0) {
+        config.ways = 0;
+    }
+    if (config.size == 0 || config.ways == 0) {
+        throw runtime_error(string("Error, --config expects <size>:<ways>[:lru|fifo], got: ") + value + "\n"
+                            + usage);
+    }
+    return config;
+}
+
+static double elapsed_ms(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *tracefile = argc > 1 ? argv[1] : nullptr;
+        SimulationContext context;
+        init_tracefile(context, &argc, &argv);
+
+        vector<BatchSim::cache_config> configs;
+        uint32_t cpuid = 0;
+        bool serial = false;
+        // argv[argc - 1] is the last option, see parse_config of assignment_3.
+        for (int i = 0; i < argc - 1; i++) {
+            bool has_value = i + 1 < argc - 1;
+            if (!strcmp(argv[i], "--config") && has_value) {
+                configs.push_back(parse_cache(argv[++i]));
+            } else if (!strcmp(argv[i], "--cpu") && has_value) {
+                char *end;
+                cpuid = (uint32_t) parse_number(argv[i], argv[i + 1], &end);
+                if (*end != '\0' || cpuid >= context.num_cpus) {
+                    throw runtime_error(string("Error, the trace has no processor ") + argv[i + 1] + "\n");
+                }
+                i++;
+            } else if (!strcmp(argv[i], "--serial")) {
+                serial = true;
+            } else {
+                throw runtime_error(string("Error, unknown option: ") + argv[i] + "\n" + usage);
+            }
+        }
+        if (configs.empty()) {
+            configs.push_back(BatchSim::cache_config{32 << 10, 8, replacement::lru});
+        }
+
+        BatchSim sim(configs);
+        auto start = chrono::steady_clock::now();
+        uint64_t entries = sim.run(tracefile, context.num_cpus, cpuid);
+        double batch_ms = elapsed_ms(start);
+        sim.print_stats(cout);
+
+        char line[256];
+        snprintf(line, sizeof(line), "Batch: %lu configurations, %lu entries, %.1f ms",
+                 (unsigned long) configs.size(), (unsigned long) entries, batch_ms);
+        cerr << line << endl;
+        if (serial) {
+            start = chrono::steady_clock::now();
+            for (const auto &config : configs) {
+                BatchSim single(vector<BatchSim::cache_config>(1, config));
+                single.run(tracefile, context.num_cpus, cpuid);
+            }
+            double serial_ms = elapsed_ms(start);
+            snprintf(line, sizeof(line), "Serial: %.1f ms, speedup %.2fx", serial_ms,
+                     batch_ms > 0 ? serial_ms / batch_ms : 0);
+            cerr << line << endl;
+        }
+        return 0;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+    }
+    return 1;
+}
@@ -0,0 +1,502 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+#include "FastSim.h"
+#include "simulation.h"
+#include <stdexcept>
+
+using namespace std;
+
+void FastSim::check_config(const sim_config &config) {
+    if (config.split_bus || config.num_buses != 1 || config.interconnect != interconnect::snooping_bus
+        || config.snoop_latency > 0 || config.cache_supply || config.merge_reads || config.loosely_timed || config.sample_ratio > 1) {
+        throw runtime_error("Error, the fast engine only models one plain snooping bus, without --split-bus, "
+                            "--buses, --noc, --snoop-latency, --cache-supply, --merge-reads, --lt and --sample\n");
+    }
+}
+
+FastSim::FastSim(SimulationContext &context, const sim_config &config, const char *tracefile)
+        : context(context), num_cpus(context.num_cpus), trace(tracefile, context.num_cpus),
+          checkpoint_at(config.checkpoint_at), memory(context, config), snoop_filter(context.num_cpus) {
+    this->init(config);
+}
+
+FastSim::FastSim(SimulationContext &context, const sim_config &config, const unsigned char *file, size_t size)
+        : context(context), num_cpus(context.num_cpus), trace(file, size, context.num_cpus),
+          checkpoint_at(config.checkpoint_at), memory(context, config), snoop_filter(context.num_cpus) {
+    this->init(config);
+}
+
+void FastSim::init(const sim_config &config) {
+    check_config(config);
+
+    this->caches = vector<cache>(this->num_cpus);
+    for (auto &c : this->caches) {
+        for (uint32_t i = 0; i < NR_SETS; i++) {
+            c.sets.push_back(new LRU(SET_SIZE, (uint8_t) i));
+        }
+        c.ack_ok = false;
+        c.data_ok = false;
+        c.ack_from = location::memory;
+    }
+    this->cpus = vector<cpu>(this->num_cpus, cpu{cpu_step::next_entry, 0, wait_flag::no_flag, 0, false, 0,
+                                                 nullptr, nullptr});
+
+    this->summaries = vector<cpu_summary>(this->num_cpus, cpu_summary{0, 0, 0, 0});
+
+    this->arbiter = Arbiter::create(config, this->num_cpus);
+}
+
+FastSim::~FastSim() {
+    for (auto &c : this->caches) {
+        for (auto set : c.sets) {
+            delete set;
+        }
+    }
+    delete this->arbiter;
+}
+
+void FastSim::save(checkpoint &state) const {
+    state.cycle = this->drained_cycle;
+    state.processors = vector<checkpoint::processor>(this->num_cpus);
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        checkpoint::processor &p = state.processors[id];
+        p.position = this->trace.position(id);
+        p.ended = this->trace.ended_for(id);
+        p.stats = this->context.stats_save(id);
+        for (auto set : this->caches[id].sets) {
+            p.sets.push_back(save_set(set));
+        }
+    }
+}
+
+void FastSim::restore(const checkpoint &state) {
+    if (state.processors.size() != this->num_cpus) {
+        throw runtime_error("Error, the checkpoint is of a trace with another number of processors\n");
+    }
+    this->first_cycle = state.cycle;
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        const checkpoint::processor &p = state.processors[id];
+        if (p.sets.size() != NR_SETS) {
+            throw runtime_error("Error, the checkpoint is of a cache with another number of sets\n");
+        }
+        for (size_t i = 0; i < NR_SETS; i++) {
+            restore_set(this->caches[id].sets[i], p.sets[i]);
+            for (const auto &line : p.sets[i]) {
+                this->snoop_filter.add(id, (line.tag * NR_SETS + i) << 5);
+            }
+        }
+        this->trace.seek(id, p.position, p.ended);
+        this->context.stats_restore(id, p.stats);
+        this->cpus[id].resume = state.cycle;
+    }
+}
+
+uint64_t FastSim::run() {
+    // The processors start at the first positive edge, after the memory.
+    uint64_t cycle = this->first_cycle;
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        this->run_cpu(id, cycle);
+    }
+    // The bus skips its first negative edge.
+    while (this->done + this->parked < this->num_cpus) {
+        cycle = this->next_cycle(cycle);
+        this->memory.posedge(cycle, this->arbiter);
+        // The processors of this edge in id order, like the modules.
+        while (!this->resumes.empty() && this->resumes.top().first == cycle) {
+            uint32_t id = this->resumes.top().second;
+            this->resumes.pop();
+            if (this->cpus[id].resume == cycle) {
+                this->run_cpu(id, cycle);
+            }
+        }
+        this->bus_negedge(cycle);
+        // Entries of processors that resume at another edge now are stale.
+        while (!this->resumes.empty() && this->cpus[this->resumes.top().second].resume != this->resumes.top().first) {
+            this->resumes.pop();
+        }
+    }
+    // The manager stops at the positive edge after the last processor
+    // finished, the memory acts before it.
+    this->memory.posedge(cycle + 1, this->arbiter);
+    return cycle + 1;
+}
+
+uint64_t FastSim::next_cycle(uint64_t cycle) const {
+    if (!this->arbiter->empty() || this->memory.busy()) {
+        return cycle + 1;
+    }
+    uint64_t next = NEVER;
+    if (this->memory.next_response() != NEVER) {
+        next = max(cycle + 1, this->memory.next_response());
+    }
+    if (!this->resumes.empty()) {
+        next = min(next, this->resumes.top().first);
+    }
+    if (next == NEVER) {
+        throw runtime_error("Error, every processor waits and nothing is in flight\n");
+    }
+    return next;
+}
+
+LRU *FastSim::set_of(uint32_t id, uint64_t addr) const {
+    return this->caches[id].sets[(addr >> 5) % NR_SETS];
+}
+
+uint64_t FastSim::tag_of(uint64_t addr) {
+    return (addr >> 5) / NR_SETS;
+}
+
+void FastSim::run_cpu(uint32_t id, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    cache &own = this->caches[id];
+    c.resume = NEVER;
+
+    switch (c.waiting) {
+        case wait_flag::ack_flag:
+            own.ack_ok = false;
+            this->context.stats_waitbus(id, (double) (cycle - c.wait_start));
+            this->summaries[id].bus_waits += 1;
+            this->summaries[id].bus_wait_cycles += cycle - c.wait_start;
+            break;
+        case wait_flag::data_flag:
+            own.data_ok = false;
+            break;
+        default:
+            break;
+    }
+    c.waiting = wait_flag::no_flag;
+
+    switch (c.step) {
+        case cpu_step::next_entry: {
+            // Like tracefile_ptr->eof(), every processor stops once all traces ended.
+            if (this->trace.eof()) {
+                c.step = cpu_step::finished;
+                this->done += 1;
+                return;
+            }
+            if (this->checkpoint_at != 0 && cycle >= this->checkpoint_at) {
+                c.step = cpu_step::stopped;
+                this->parked += 1;
+                this->drained_cycle = cycle;
+                return;
+            }
+            uint64_t addr = 0;
+            TraceFile::EntryType type = this->trace.next(id, &addr);
+            switch (type) {
+                case TraceFile::ENTRY_TYPE_READ:
+                case TraceFile::ENTRY_TYPE_WRITE:
+                    c.write = type == TraceFile::ENTRY_TYPE_WRITE;
+                    c.addr = addr;
+                    this->start_access(id, cycle);
+                    break;
+                case TraceFile::ENTRY_TYPE_NOP:
+                    this->access_done(id, cycle);
+                    break;
+                default:
+                    throw runtime_error("Error, got invalid data from Trace\n");
+            }
+            break;
+        }
+        case cpu_step::read_hit:
+            this->context.stats_readhit(id);
+            this->summaries[id].hits += 1;
+            if (c.line->status == cache_status::invalid) {
+                // A snoop took the line since the hit, push2head puts it back.
+                this->snoop_filter.add(id, c.addr);
+            }
+            c.lru->push2head(c.line);
+            this->access_done(id, cycle);
+            break;
+        case cpu_step::write_hit:
+            this->send_to_bus(id, op_type::probe_write, location::all, c.addr, cycle);
+            this->wait_for(id, wait_flag::ack_flag, cpu_step::write_hit_done, cycle);
+            break;
+        case cpu_step::write_hit_done:
+            if (c.line->status == cache_status::invalid) {
+                this->snoop_filter.add(id, c.addr);
+            }
+            c.line->status = cache_status::modified;
+            this->context.stats_writehit(id);
+            this->summaries[id].hits += 1;
+            c.lru->push2head(c.line);
+            this->access_done(id, cycle);
+            break;
+        case cpu_step::evict_acked:
+            this->wait_for(id, wait_flag::data_flag, cpu_step::evicted, cycle);
+            break;
+        case cpu_step::evicted:
+            this->evict(id);
+            c.line = c.lru->get_clean_node();
+            this->fill(id, cycle);
+            break;
+        case cpu_step::fill_acked:
+            // The line is shared if another cache had it when the read was granted.
+            switch (own.ack_from) {
+                case location::memory:
+                    c.line->status = cache_status::exclusive;
+                    break;
+                case location::cache:
+                    c.line->status = cache_status::shared;
+                    break;
+                default:
+                    break;
+            }
+            this->wait_for(id, wait_flag::data_flag, cpu_step::filled, cycle);
+            break;
+        case cpu_step::filled:
+            c.line->has_data = true;
+            this->fill(id, cycle);
+            break;
+        case cpu_step::write_miss_done:
+            c.line->status = cache_status::modified;
+            this->access_done(id, cycle);
+            break;
+        case cpu_step::finished:
+        case cpu_step::stopped:
+            break;
+    }
+}
+
+void FastSim::start_access(uint32_t id, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    this->summaries[id].accesses += 1;
+    c.lru = this->set_of(id, c.addr);
+    c.line = c.lru->find(tag_of(c.addr));
+
+    if (c.line != nullptr) {
+        // A hit takes a cycle.
+        c.step = c.write ? cpu_step::write_hit : cpu_step::read_hit;
+        this->resume_at(id, cycle + 1);
+        return;
+    }
+
+    if (c.write) {
+        this->context.stats_writemiss(id);
+    } else {
+        this->context.stats_readmiss(id);
+    }
+    if (!this->make_room(id, cycle)) {
+        return;
+    }
+    if (c.line == nullptr) {
+        // No clean line although the set is not full, Cache gives up too.
+        this->access_done(id, cycle);
+        return;
+    }
+    this->fill(id, cycle);
+}
+
+bool FastSim::make_room(uint32_t id, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    if (!c.lru->is_full()) {
+        c.line = c.lru->get_clean_node();
+        return true;
+    }
+
+    c.line = c.lru->tail;
+    if (c.line->status == cache_status::modified || c.line->status == cache_status::owned) {
+        uint64_t set_i = (c.addr >> 5) % NR_SETS;
+        uint64_t victim = (c.line->tag * NR_SETS + set_i) << 5;
+        this->send_to_bus(id, op_type::probe_write, location::memory, victim, cycle);
+        this->wait_for(id, wait_flag::ack_flag, cpu_step::evict_acked, cycle);
+        return false;
+    }
+    this->evict(id);
+    c.line = c.lru->get_clean_node();
+    return true;
+}
+
+void FastSim::evict(uint32_t id) {
+    cpu &c = this->cpus[id];
+    uint64_t set_i = (c.addr >> 5) % NR_SETS;
+    uint64_t victim = (c.line->tag * NR_SETS + set_i) << 5;
+    c.lru->invalid(c.line);
+    this->snoop_filter.remove(id, victim);
+}
+
+void FastSim::fill(uint32_t id, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    // An invalidation while the line was on its way starts the read again.
+    if (c.line->status == cache_status::invalid) {
+        c.line->tag = tag_of(c.addr);
+        c.line->has_data = false;
+        c.lru->push2head(c.line);
+        c.lru->size += 1;
+        this->snoop_filter.add(id, c.addr);
+
+        this->send_to_bus(id, op_type::probe_read, location::all, c.addr, cycle);
+        this->wait_for(id, wait_flag::ack_flag, cpu_step::fill_acked, cycle);
+        return;
+    }
+
+    if (!c.write) {
+        this->access_done(id, cycle);
+        return;
+    }
+    this->send_to_bus(id, op_type::probe_write, location::all, c.addr, cycle);
+    this->wait_for(id, wait_flag::ack_flag, cpu_step::write_miss_done, cycle);
+}
+
+void FastSim::access_done(uint32_t id, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    c.step = cpu_step::next_entry;
+    this->resume_at(id, cycle + 1);
+}
+
+void FastSim::wait_for(uint32_t id, wait_flag flag, cpu_step step, uint64_t cycle) {
+    cpu &c = this->cpus[id];
+    const cache &own = this->caches[id];
+    c.step = step;
+    c.waiting = flag;
+    c.wait_start = cycle;
+    // A flag that is already set is seen at the next edge.
+    bool set = flag == wait_flag::ack_flag ? own.ack_ok : own.data_ok;
+    if (set) {
+        this->resume_at(id, cycle + 1);
+    } else {
+        c.resume = NEVER;
+    }
+}
+
+void FastSim::resume_at(uint32_t id, uint64_t cycle) {
+    this->cpus[id].resume = cycle;
+    this->resumes.emplace(cycle, id);
+}
+
+void FastSim::raise(uint32_t id, wait_flag flag, uint64_t cycle) {
+    cache &own = this->caches[id];
+    if (flag == wait_flag::ack_flag) {
+        own.ack_ok = true;
+    } else {
+        own.data_ok = true;
+    }
+    cpu &c = this->cpus[id];
+    if (c.waiting == flag && c.resume == NEVER) {
+        this->resume_at(id, cycle + 1);
+    }
+}
+
+void FastSim::send_to_bus(uint32_t id, op_type op, location destination, uint64_t addr, uint64_t cycle) {
+    request req;
+    req.source = location::cache;
+    req.sender_id = (uint16_t) id;
+    req.receiver_id = 0;
+    req.addr = addr;
+    req.op = op;
+    req.destination = destination;
+    this->push(this->caches[id].send_buffer, req);
+
+    request_id rid;
+    rid.source = location::cache;
+    rid.cpu_id = (uint16_t) id;
+    this->arbiter->push(rid, cycle);
+}
+
+void FastSim::snoop(uint32_t id, const request &event, uint64_t cycle) {
+    LRU *lru = this->set_of(id, event.addr);
+    LRUnit *line = lru->find(tag_of(event.addr));
+    if (line == nullptr) return;
+
+    switch (event.op) {
+        case data_transfer:
+            if (event.receiver_id == id) {
+                // This cache supplies the line, the transitions are the ones of a read.
+                request message = event;
+                message.receiver_id = message.sender_id;
+                message.sender_id = (uint16_t) id;
+                this->push(this->caches[id].send_buffer, message);
+
+                request_id rid;
+                rid.source = location::cache;
+                rid.cpu_id = (uint16_t) id;
+                this->arbiter->push(rid, cycle);
+            }
+        case probe_read:
+            line->status = snooped(line->status, false);
+            break;
+        case probe_write:
+            lru->invalid(line);
+            break;
+    }
+}
+
+void FastSim::bus_negedge(uint64_t cycle) {
+    if (cycle == this->first_cycle || this->arbiter->empty()) {
+        return;
+    }
+    request_id id = this->arbiter->grant(cycle);
+    RingBuffer<request> *buffer;
+    if (id.source == location::memory) {
+        buffer = &this->memory.grant();
+    } else {
+        buffer = &this->caches[id.cpu_id].send_buffer;
+        this->raise(id.cpu_id, wait_flag::ack_flag, cycle);
+    }
+    // Drained in place like Bus::arbitrate, the snoops fill other buffers.
+    for (size_t burst = buffer->size(); burst > 0; burst--) {
+        this->send_request(buffer->front(), cycle);
+        buffer->pop();
+    }
+}
+
+void FastSim::send_request(request req, uint64_t cycle) {
+    switch (req.op) {
+        case probe_read: {
+            location data_location = location::memory;
+            uint32_t holder = 0;
+            this->snoop_filter.sharers(req.addr, this->snoop_targets);
+            for (uint32_t i : this->snoop_targets) {
+                const LRUnit *line = this->set_of(i, req.addr)->find(tag_of(req.addr));
+                if (line != nullptr && line->status != cache_status::invalid) {
+                    data_location = location::cache;
+                    holder = i;
+                    break;
+                }
+            }
+            this->caches[req.sender_id].ack_from = data_location;
+
+            // The requester has no data during a miss, so the line comes from memory.
+            const LRUnit *own = this->set_of(req.sender_id, req.addr)->find(tag_of(req.addr));
+            if (own == nullptr || !own->has_data) {
+                data_location = location::memory;
+            }
+            if (data_location == location::cache) {
+                req.op = op_type::data_transfer;
+                req.receiver_id = (uint16_t) holder;
+            }
+            for (uint32_t i : this->snoop_targets) {
+                if (i != req.sender_id) {
+                    this->snoop(i, req, cycle);
+                }
+            }
+            if (data_location == location::memory) {
+                this->memory.push(req);
+            }
+            break;
+        }
+        case probe_write:
+            if (req.destination == location::all) {
+                this->snoop_filter.sharers(req.addr, this->snoop_targets);
+                for (uint32_t i : this->snoop_targets) {
+                    if (i != req.sender_id) {
+                        this->snoop(i, req, cycle);
+                    }
+                }
+                this->snoop_filter.invalidate_others(req.sender_id, req.addr);
+            }
+            if (req.destination == location::memory) {
+                this->memory.push(req);
+            }
+            break;
+        case data_transfer:
+            this->raise(req.receiver_id, wait_flag::data_flag, cycle);
+            break;
+    }
+}
+
+void FastSim::print_stats(std::ostream &os, uint64_t cycles) const {
+    os << "bus_0" << endl;
+    this->arbiter->print_stats(os);
+    this->memory.print_stats(os, cycles);
+}
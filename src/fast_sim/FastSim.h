@@ -0,0 +1,203 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+
+#ifndef FRAMEWORK_FAST_SIM_H
+#define FRAMEWORK_FAST_SIM_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include "../assignment_3/Arbiter.h"
+#include "../assignment_3/Checkpoint.h"
+#include "../assignment_3/config.h"
+#include "../assignment_3/lru.h"
+#include "../assignment_3/ring_buffer.h"
+#include "../assignment_3/SnoopFilter.h"
+#include "../assignment_3/TraceBuffer.h"
+#include "../assignment_3/types.h"
+#include "cache_size.h"
+#include "MemoryPort.h"
+
+/*
+ * The cache coherence model of assignment_3 without the SystemC kernel.
+ * Caches, bus and memory keep the MOESI transitions and the timing of the
+ * SystemC modules: processors and memory act at the positive edge, the bus
+ * at the negative edge, and a processor that waits for the bus sleeps
+ * until the edge after its flag was set. Every processor is a state
+ * machine whose step says where it resumes, cycles in which nothing
+ * happens are skipped. Arbiter, LRU and the memory controller are the ones
+ * of assignment_3.
+ * Only the plain snooping bus is modelled, one bus without split
+ * transactions, snoop timing or read merging.
+ */
+
+// What a processor did, the accuracy report of ParallelSim compares it.
+typedef struct cpu_summary {
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t bus_waits;      // bus transactions the processor waited for.
+    uint64_t bus_wait_cycles;
+} cpu_summary;
+
+class FastSim {
+public:
+    // `tracefile` is the trace of `context`, it is read into memory. The
+    // statistics go to `context`.
+    FastSim(SimulationContext &context, const sim_config &config, const char *tracefile);
+
+    // The tracefile in memory, see TraceBuffer.
+    FastSim(SimulationContext &context, const sim_config &config, const unsigned char *file, size_t size);
+
+    ~FastSim();
+
+    // Throws for the options the fast engines do not model.
+    static void check_config(const sim_config &config);
+
+    // Runs the trace to the end, or until every processor stopped for the
+    // checkpoint, returns the cycle the simulation stopped at.
+    uint64_t run();
+
+    // Every processor stopped for the checkpoint, see Manager.h.
+    bool drained() const {
+        return this->parked == this->num_cpus;
+    }
+
+    // The checkpoint after a drained run.
+    void save(checkpoint &state) const;
+
+    // Continues from a checkpoint, before run.
+    void restore(const checkpoint &state);
+
+    // The bus and memory statistics of assignment_3 after `cycles`, the
+    // processor table is printed by stats_print.
+    void print_stats(std::ostream &os, uint64_t cycles) const;
+
+    const std::vector<cpu_summary> &summary() const {
+        return this->summaries;
+    }
+
+private:
+    static const uint64_t NEVER = UINT64_MAX;
+
+    // Where a processor resumes, one step per wait() of CPU and Cache.
+    enum cpu_step {
+        next_entry = 0,     // the head of the trace loop.
+        read_hit = 1,       // a cycle after a read hit.
+        write_hit = 2,      // a cycle after a write hit.
+        write_hit_done = 3, // the invalidation of a write hit was granted.
+        evict_acked = 4,    // the write back was granted.
+        evicted = 5,        // the write back reached the memory.
+        fill_acked = 6,     // the read of the line was granted.
+        filled = 7,         // the line arrived.
+        write_miss_done = 8, // the invalidation of a write miss was granted.
+        finished = 9,
+        stopped = 10,       // stopped for the checkpoint.
+    };
+
+    enum wait_flag {
+        no_flag = 0,
+        ack_flag = 1,
+        data_flag = 2,
+    };
+
+    typedef struct cache {
+        std::vector<LRU *> sets;
+        RingBuffer<request> send_buffer;
+        bool ack_ok;
+        bool data_ok;
+        location ack_from;
+    } cache;
+
+    typedef struct cpu {
+        cpu_step step;
+        uint64_t resume;  // positive edge it continues at, NEVER while it waits for a flag.
+        wait_flag waiting;
+        uint64_t wait_start;
+        bool write;
+        uint64_t addr;
+        LRU *lru;
+        LRUnit *line;
+    } cpu;
+
+    SimulationContext &context;
+    uint32_t num_cpus;
+    TraceBuffer trace;
+    std::vector<cache> caches;
+    std::vector<cpu> cpus;
+    // The processors by the edge they resume at, then by id. An entry is
+    // stale once its processor resumes at another edge.
+    std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>,
+            std::greater<std::pair<uint64_t, uint32_t>>> resumes;
+    std::vector<cpu_summary> summaries;
+    uint32_t done = 0;
+
+    uint64_t first_cycle = 0;    // the cycle of a restored checkpoint.
+    uint64_t checkpoint_at;      // 0 without a checkpoint.
+    uint32_t parked = 0;
+    uint64_t drained_cycle = 0;  // the cycle the last processor stopped at.
+
+    Arbiter *arbiter;
+    MemoryPort memory;
+    // The caches a snoop visits, see SnoopFilter.
+    SnoopFilter snoop_filter;
+    std::vector<uint32_t> snoop_targets;
+
+    // The part of the constructors after the trace.
+    void init(const sim_config &config);
+
+    void run_cpu(uint32_t id, uint64_t cycle);
+
+    // The part of cpu_read and cpu_write before their first wait.
+    void start_access(uint32_t id, uint64_t cycle);
+
+    // Evicts the tail of a full set, false if its write back has to wait.
+    bool make_room(uint32_t id, uint64_t cycle);
+
+    // Drops the line of processor `id` from its cache.
+    void evict(uint32_t id);
+
+    // The fill loop of a miss, continues with the invalidation of a write.
+    void fill(uint32_t id, uint64_t cycle);
+
+    // The wait() after an access, the next entry is read a cycle later.
+    void access_done(uint32_t id, uint64_t cycle);
+
+    void wait_for(uint32_t id, wait_flag flag, cpu_step step, uint64_t cycle);
+
+    // The processor continues at the positive edge of `cycle`.
+    void resume_at(uint32_t id, uint64_t cycle);
+
+    // Sets the flag of a cache at a negative edge, its processor resumes at
+    // the next positive edge if it waits for it.
+    void raise(uint32_t id, wait_flag flag, uint64_t cycle);
+
+    void send_to_bus(uint32_t id, op_type op, location destination, uint64_t addr, uint64_t cycle);
+
+    // A full buffer grows, like the send buffers of Cache.
+    static void push(RingBuffer<request> &buffer, const request &req) {
+        if (buffer.full()) {
+            buffer.grow();
+        }
+        buffer.push(req);
+    }
+
+    void snoop(uint32_t id, const request &event, uint64_t cycle);
+
+    void bus_negedge(uint64_t cycle);
+
+    void send_request(request req, uint64_t cycle);
+
+    // The next positive edge after the negative edge of `cycle` at which
+    // something happens.
+    uint64_t next_cycle(uint64_t cycle) const;
+
+    LRU *set_of(uint32_t id, uint64_t addr) const;
+
+    static uint64_t tag_of(uint64_t addr);
+};
+
+#endif //FRAMEWORK_FAST_SIM_H
@@ -0,0 +1,67 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+#include "MemoryPort.h"
+#include "simulation.h"
+
+using namespace std;
+
+MemoryPort::MemoryPort(SimulationContext &context, const sim_config &config) : context(context) {
+    this->controller = MemoryController::create(config);
+}
+
+MemoryPort::~MemoryPort() {
+    delete this->controller;
+}
+
+void MemoryPort::posedge(uint64_t cycle, Arbiter *arbiter) {
+    // send_response of Memory.h.
+    bool send = true;
+    if (this->waiting_ack) {
+        if (this->ack_ok) {
+            this->ack_ok = false;
+            this->waiting_ack = false;
+        } else {
+            send = false;
+        }
+    }
+    if (send && !this->pipeline.empty() && this->pipeline.top().ready <= cycle) {
+        if (this->send_buffer.full()) {
+            this->send_buffer.grow();
+        }
+        this->send_buffer.push(this->pipeline.top().req);
+        this->pipeline.pop();
+
+        request_id rid;
+        rid.source = location::memory;
+        rid.cpu_id = 0;
+        arbiter->push(rid, cycle);
+        this->waiting_ack = true;
+    }
+
+    // dispatch of Memory.h.
+    if (!this->requests.empty()) {
+        const request &req = this->requests.front();
+        if (this->controller->enqueue(req, cycle)) {
+            this->context.stats_memory_access(req.sender_id, 1);
+            this->requests.pop();
+        }
+    }
+    this->started.clear();
+    this->controller->step(cycle, this->started);
+    for (auto &access : this->started) {
+        request response;
+        response.addr = access.req.addr;
+        response.source = location::memory;
+        response.destination = location::cache;
+        response.sender_id = 0;
+        response.receiver_id = access.req.sender_id;
+        response.op = op_type::data_transfer;
+        this->pipeline.push(task{response, access.ready, this->next_seq++});
+    }
+}
+
+RingBuffer<request> &MemoryPort::grant() {
+    this->ack_ok = true;
+    return this->send_buffer;
+}
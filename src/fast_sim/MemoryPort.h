@@ -0,0 +1,86 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+
+#ifndef FRAMEWORK_MEMORY_PORT_H
+#define FRAMEWORK_MEMORY_PORT_H
+
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include "../assignment_3/Arbiter.h"
+#include "../assignment_3/MemoryController.h"
+#include "../assignment_3/config.h"
+#include "../assignment_3/ring_buffer.h"
+#include "../assignment_3/types.h"
+
+class SimulationContext;
+
+/*
+ * The memory of assignment_3 behind one bus, see Memory.h: it accepts a
+ * request per positive edge and sends a response per bus grant, in the
+ * order the banks finish.
+ */
+class MemoryPort {
+public:
+    // The memory cycles go to the statistics of `context`.
+    MemoryPort(SimulationContext &context, const sim_config &config);
+
+    ~MemoryPort();
+
+    // A read or write back the bus sent to the memory.
+    void push(const request &req) {
+        if (this->requests.full()) {
+            this->requests.grow();
+        }
+        this->requests.push(req);
+    }
+
+    // send_response and dispatch of Memory.h, a response asks `arbiter` for the bus.
+    void posedge(uint64_t cycle, Arbiter *arbiter);
+
+    // The responses that go on the bus when the memory is granted, the
+    // bus drains them in place.
+    RingBuffer<request> &grant();
+
+    // Whether the memory acts at the next positive edge whatever happens.
+    bool busy() const {
+        return !this->requests.empty() || !this->controller->idle() || (this->waiting_ack && this->ack_ok);
+    }
+
+    // The positive edge of the earliest response that can be sent, UINT64_MAX if none.
+    uint64_t next_response() const {
+        return this->pipeline.empty() || this->waiting_ack ? UINT64_MAX : this->pipeline.top().ready;
+    }
+
+    void print_stats(std::ostream &os, uint64_t cycles) const {
+        this->controller->print_stats(os, cycles);
+    }
+
+private:
+    typedef struct task {
+        request req;
+        uint64_t ready;
+        uint64_t seq;
+    } task;
+
+    typedef struct later {
+        bool operator()(const task &a, const task &b) const {
+            return a.ready != b.ready ? a.ready > b.ready : a.seq > b.seq;
+        }
+    } later;
+
+    SimulationContext &context;
+    MemoryController *controller;
+    RingBuffer<request> requests;
+    RingBuffer<request> send_buffer;
+    std::priority_queue<task, std::vector<task>, later> pipeline;
+    bool ack_ok = false;
+    bool waiting_ack = false;
+    std::vector<MemoryController::access> started;
+    uint64_t next_seq = 0;
+};
+
+#endif //FRAMEWORK_MEMORY_PORT_H
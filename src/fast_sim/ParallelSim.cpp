@@ -0,0 +1,422 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+#include "ParallelSim.h"
+#include "simulation.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+void ParallelSim::barrier::wait() {
+    unique_lock<mutex> guard(this->lock);
+    uint64_t current = this->generation;
+    this->arrived += 1;
+    if (this->arrived == this->count) {
+        this->arrived = 0;
+        this->generation += 1;
+        this->all_arrived.notify_all();
+        return;
+    }
+    this->all_arrived.wait(guard, [this, current] { return this->generation != current; });
+}
+
+ParallelSim::ParallelSim(SimulationContext &context, const sim_config &config, const char *tracefile,
+                         uint32_t threads, uint64_t quantum)
+        : context(context), num_cpus(context.num_cpus), num_threads(min(threads, context.num_cpus)), quantum(quantum),
+          trace(tracefile, context.num_cpus), memory(context, config), snoop_filter(context.num_cpus),
+          sync(min(threads, context.num_cpus)) {
+    FastSim::check_config(config);
+    if (threads == 0 || quantum == 0) {
+        throw runtime_error("Error, the parallel engine needs at least one thread and one cycle per quantum\n");
+    }
+    if (config.checkpoint_file != nullptr || config.restore_file != nullptr || config.warmup_entries > 0
+        || config.warmup_percent > 0) {
+        throw runtime_error("Error, the parallel engine neither takes nor restores checkpoints or warm-ups\n");
+    }
+    if (this->num_cpus > VALIDATED_CPUS) {
+        cerr << "WARNING: the parallel engine is validated up to " << VALIDATED_CPUS << " processors, not "
+             << this->num_cpus << ", its cycles can be off by more than 10% on a busy bus" << endl;
+    }
+
+    core empty;
+    empty.clock = 0;
+    empty.ended = false;
+    empty.state = event_state::waiting;
+    empty.issue_at = 0;
+    empty.delay = 0;
+    empty.refill = false;
+    this->cores = vector<core>(this->num_cpus, empty);
+    for (auto &c : this->cores) {
+        for (uint32_t i = 0; i < NR_SETS; i++) {
+            c.sets.push_back(new LRU(SET_SIZE, (uint8_t) i));
+        }
+    }
+    this->summaries = vector<cpu_summary>(this->num_cpus, cpu_summary{0, 0, 0, 0});
+
+    this->arbiter = Arbiter::create(config, this->num_cpus);
+}
+
+ParallelSim::~ParallelSim() {
+    for (auto &c : this->cores) {
+        for (auto set : c.sets) {
+            delete set;
+        }
+    }
+    delete this->arbiter;
+}
+
+uint64_t ParallelSim::run() {
+    // The calling thread is worker 0.
+    for (uint32_t worker = 1; worker < this->num_threads; worker++) {
+        this->workers.emplace_back(&ParallelSim::work, this, worker);
+    }
+
+    bool ended = false;
+    while (!ended) {
+        this->bound_end += this->quantum;
+        this->quanta += 1;
+        if (this->num_threads > 1) {
+            this->sync.wait();
+        }
+        this->bound(0);
+        if (this->num_threads > 1) {
+            this->sync.wait();
+        }
+
+        ended = all_of(this->cores.begin(), this->cores.end(), [](const core &c) { return c.ended; });
+        // The last weave phase finishes every transaction.
+        this->weave(ended ? NEVER : this->bound_end);
+    }
+
+    this->stopping = true;
+    if (this->num_threads > 1) {
+        this->sync.wait();
+    }
+    for (auto &worker : this->workers) {
+        worker.join();
+    }
+
+    // Every processor stops at the entry after its trace ended, like the
+    // last one in FastSim, the manager a cycle later.
+    int64_t last = 0;
+    for (const auto &c : this->cores) {
+        last = max(last, (int64_t) c.clock + c.delay);
+    }
+    return (uint64_t) last + 1;
+}
+
+void ParallelSim::work(uint32_t worker) {
+    for (;;) {
+        this->sync.wait();
+        if (this->stopping) {
+            return;
+        }
+        this->bound(worker);
+        this->sync.wait();
+    }
+}
+
+void ParallelSim::bound(uint32_t worker) {
+    for (uint32_t id = worker; id < this->num_cpus; id += this->num_threads) {
+        core &c = this->cores[id];
+        while (!c.ended && (int64_t) c.clock + c.delay < (int64_t) this->bound_end) {
+            uint64_t addr = 0;
+            TraceFile::EntryType type = this->trace.next(id, &addr);
+            if (type == TraceFile::ENTRY_TYPE_READ || type == TraceFile::ENTRY_TYPE_WRITE) {
+                this->access(id, type == TraceFile::ENTRY_TYPE_WRITE, addr);
+                continue;
+            }
+            // A NOP, also the one for the end of the trace.
+            c.ended = this->trace.ended_for(id);
+            c.clock += 1;
+        }
+    }
+}
+
+uint64_t ParallelSim::zero_load(event_kind kind) {
+    // The ack comes a cycle after the request, the data a cycle after the
+    // memory has it.
+    return kind == event_kind::invalidate ? 1 : MEMORY_LATENCY + 2;
+}
+
+void ParallelSim::record(uint32_t id, event_kind kind, uint64_t addr, uint64_t *cycle, bool miss) {
+    RingBuffer<event> &events = this->cores[id].events;
+    if (events.full()) {
+        events.grow();
+    }
+    events.push(event{kind, addr, *cycle, miss});
+    *cycle += zero_load(kind);
+}
+
+void ParallelSim::access(uint32_t id, bool write, uint64_t addr) {
+    core &c = this->cores[id];
+    uint64_t cycle = c.clock;
+    this->summaries[id].accesses += 1;
+
+    uint64_t set = (addr >> 5) % NR_SETS;
+    LRU *lru = c.sets[set];
+    LRUnit *line = lru->find((addr >> 5) / NR_SETS);
+    if (line != nullptr) {
+        // A hit takes a cycle, a write invalidates the other copies after it.
+        this->summaries[id].hits += 1;
+        lru->push2head(line);
+        if (write) {
+            this->context.stats_writehit(id);
+            line->status = cache_status::modified;
+            cycle += 1;
+            this->record(id, event_kind::invalidate, addr, &cycle);
+        } else {
+            this->context.stats_readhit(id);
+            cycle += 1;
+        }
+        c.clock = cycle + 1;
+        return;
+    }
+
+    if (write) {
+        this->context.stats_writemiss(id);
+    } else {
+        this->context.stats_readmiss(id);
+    }
+    // The tail of a full set makes room, like in FastSim::make_room.
+    if (lru->is_full()) {
+        LRUnit *victim = lru->tail;
+        uint64_t victim_addr = (victim->tag * NR_SETS + set) << 5;
+        if (victim->status == cache_status::modified || victim->status == cache_status::owned) {
+            this->record(id, event_kind::write_back, victim_addr, &cycle);
+        }
+        lru->invalid(victim);
+        c.changes.push_back((victim_addr >> 5) << 1);
+    }
+    line = lru->get_clean_node();
+    if (line == nullptr) {
+        // No clean line although the set is not full, FastSim gives up too.
+        c.clock = cycle + 1;
+        return;
+    }
+    line->tag = (addr >> 5) / NR_SETS;
+    line->has_data = false;
+    lru->push2head(line);
+    lru->size += 1;
+    c.changes.push_back((addr >> 5) << 1 | 1);
+
+    // The weave phase makes the line shared if another cache has it.
+    line->status = cache_status::exclusive;
+    this->record(id, event_kind::fill, addr, &cycle);
+    if (write) {
+        line->status = cache_status::modified;
+        this->record(id, event_kind::invalidate, addr, &cycle, true);
+    }
+    c.clock = cycle + 1;
+}
+
+void ParallelSim::weave(uint64_t end) {
+    // Transactions recorded after their processor went idle start now at the earliest.
+    this->issues = decltype(this->issues)();
+    for (uint32_t id = 0; id < this->num_cpus; id++) {
+        for (uint64_t change : this->cores[id].changes) {
+            if (change & 1) {
+                this->snoop_filter.add(id, (change >> 1) << 5);
+            } else {
+                this->snoop_filter.remove(id, (change >> 1) << 5);
+            }
+        }
+        this->cores[id].changes.clear();
+        if (this->cores[id].state == event_state::waiting) {
+            this->schedule(id, this->woven);
+        }
+    }
+
+    for (uint64_t cycle = this->next_cycle(this->woven); cycle < end; cycle = this->next_cycle(cycle + 1)) {
+        this->memory.posedge(cycle, this->arbiter);
+        while (!this->issues.empty() && this->issues.top().first == cycle) {
+            uint32_t id = this->issues.top().second;
+            this->issues.pop();
+
+            request_id rid;
+            rid.source = location::cache;
+            rid.cpu_id = (uint16_t) id;
+            this->arbiter->push(rid, cycle);
+            this->cores[id].state = event_state::requested;
+        }
+        this->bus_negedge(cycle);
+        this->woven = cycle + 1;
+    }
+    this->woven = max(this->woven, end);
+}
+
+uint64_t ParallelSim::next_cycle(uint64_t cycle) const {
+    if (!this->arbiter->empty() || this->memory.busy()) {
+        return cycle;
+    }
+    uint64_t next = NEVER;
+    if (this->memory.next_response() != NEVER) {
+        next = max(cycle, this->memory.next_response());
+    }
+    if (!this->issues.empty()) {
+        next = min(next, max(cycle, this->issues.top().first));
+    }
+    return next;
+}
+
+void ParallelSim::bus_negedge(uint64_t cycle) {
+    // The bus skips its first negative edge.
+    if (cycle == 0 || this->arbiter->empty()) {
+        return;
+    }
+    request_id id = this->arbiter->grant(cycle);
+    if (id.source == location::memory) {
+        RingBuffer<request> &responses = this->memory.grant();
+        for (; !responses.empty(); responses.pop()) {
+            this->complete(responses.front().receiver_id, cycle + 1);
+        }
+        return;
+    }
+
+    core &c = this->cores[id.cpu_id];
+    const event &ev = c.events.front();
+    this->context.stats_waitbus(id.cpu_id, (double) (cycle + 1 - c.issue_at));
+    this->summaries[id.cpu_id].bus_waits += 1;
+    this->summaries[id.cpu_id].bus_wait_cycles += cycle + 1 - c.issue_at;
+    this->snoop(id.cpu_id, ev);
+
+    if (ev.kind == event_kind::invalidate) {
+        this->complete(id.cpu_id, cycle + 1);
+        return;
+    }
+    request req;
+    req.source = location::cache;
+    req.destination = location::memory;
+    req.sender_id = id.cpu_id;
+    req.receiver_id = 0;
+    req.addr = ev.addr;
+    req.op = ev.kind == event_kind::fill ? op_type::probe_read : op_type::probe_write;
+    this->memory.push(req);
+    c.state = event_state::acked;
+}
+
+void ParallelSim::snoop(uint32_t id, const event &ev) {
+    if (ev.kind == event_kind::write_back) {
+        return;
+    }
+    bool invalidate = ev.kind == event_kind::invalidate;
+    uint64_t tag = (ev.addr >> 5) / NR_SETS;
+    bool shared = false;
+    this->relinked.clear();
+    this->snoop_filter.sharers(ev.addr, this->snoop_targets);
+    for (uint32_t other : this->snoop_targets) {
+        if (other == id) continue;
+        LRU *lru = this->set_of(other, ev.addr);
+        LRUnit *line = lru->find(tag);
+        if (line == nullptr) continue;
+
+        // In FastSim a line is valid once its read was granted.
+        const core &o = this->cores[other];
+        bool reading = !o.events.empty() && o.events.front().kind == event_kind::fill
+                && (o.events.front().addr >> 5) == (ev.addr >> 5) && o.state != event_state::acked;
+        if (invalidate) {
+            this->invalidate_line(other, lru, line, ev.addr);
+        } else if (!reading) {
+            shared = true;
+            line->status = snooped(line->status, false);
+        }
+    }
+    if (invalidate) {
+        this->snoop_filter.invalidate_others(id, ev.addr);
+        for (uint32_t other : this->relinked) {
+            this->snoop_filter.add(other, ev.addr);
+        }
+    }
+
+    LRUnit *own = this->set_of(id, ev.addr)->find(tag);
+    if (ev.kind == event_kind::fill && shared && own != nullptr && own->status == cache_status::exclusive) {
+        own->status = cache_status::shared;
+    }
+}
+
+void ParallelSim::invalidate_line(uint32_t id, LRU *lru, LRUnit *line, uint64_t addr) {
+    core &c = this->cores[id];
+    const event *front = c.events.empty() ? nullptr : &c.events.front();
+    bool waits = front != nullptr && (front->addr >> 5) == (addr >> 5) && front->kind != event_kind::write_back;
+    if (waits && front->kind == event_kind::fill && c.state == event_state::waiting) {
+        // FastSim reads the line only after this invalidation.
+        this->relinked.push_back(id);
+        return;
+    }
+    lru->invalid(line);
+    if (!waits || c.state == event_state::waiting) {
+        return;
+    }
+    if (front->kind == event_kind::fill) {
+        if (c.state == event_state::requested) {
+            // The grant of the read makes it valid again, outside of the set.
+            line->status = cache_status::exclusive;
+        } else {
+            // The data arrives for a line that is gone, it is read again.
+            c.refill = true;
+        }
+    } else {
+        // The grant of the invalidation makes it modified, a write hit puts
+        // it back without counting it.
+        line->status = cache_status::modified;
+        if (!front->miss) {
+            lru->push2head(line);
+            this->relinked.push_back(id);
+        }
+    }
+}
+
+void ParallelSim::complete(uint32_t id, uint64_t cycle) {
+    core &c = this->cores[id];
+    if (c.refill) {
+        // Back into the set if the bound phase did not reuse the way, and
+        // the read goes to the bus again.
+        c.refill = false;
+        const event &again = c.events.front();
+        LRU *lru = this->set_of(id, again.addr);
+        uint64_t tag = (again.addr >> 5) / NR_SETS;
+        for (uint8_t i = 0; i < lru->capacity && lru->find(tag) == nullptr; i++) {
+            LRUnit *line = &lru->lines[i];
+            if (line->tag == tag && line->status == cache_status::invalid && line != lru->head
+                && line->prev == nullptr) {
+                line->status = cache_status::exclusive;
+                lru->push2head(line);
+                lru->size += 1;
+                this->snoop_filter.add(id, again.addr);
+            }
+        }
+        c.state = event_state::waiting;
+        c.delay = (int64_t) cycle - (int64_t) again.issue;
+        this->schedule(id, cycle);
+        return;
+    }
+    event done = c.events.front();
+    c.events.pop();
+    c.state = event_state::waiting;
+
+    // The bound phase went on as if it finished without contention.
+    c.delay = (int64_t) cycle - (int64_t) (done.issue + zero_load(done.kind));
+    this->schedule(id, cycle);
+}
+
+void ParallelSim::schedule(uint32_t id, uint64_t cycle) {
+    core &c = this->cores[id];
+    if (c.events.empty()) {
+        return;
+    }
+    int64_t issue = max((int64_t) c.events.front().issue + c.delay, (int64_t) 0);
+    c.issue_at = max((uint64_t) issue, cycle);
+    this->issues.emplace(c.issue_at, id);
+}
+
+void ParallelSim::print_stats(std::ostream &os, uint64_t cycles) const {
+    char line[256];
+    snprintf(line, sizeof(line), "Parallel: %u thread(s), %lu quanta of %lu cycle(s)", this->num_threads,
+             (unsigned long) this->quanta, (unsigned long) this->quantum);
+    os << line << endl;
+    os << "bus_0" << endl;
+    this->arbiter->print_stats(os);
+    this->memory.print_stats(os, cycles);
+}
@@ -0,0 +1,184 @@
+//
+// Created by yanghoo on 3/13/24.
+//
+
+#ifndef FRAMEWORK_PARALLEL_SIM_H
+#define FRAMEWORK_PARALLEL_SIM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "../assignment_3/Arbiter.h"
+#include "../assignment_3/SnoopFilter.h"
+#include "../assignment_3/config.h"
+#include "../assignment_3/TraceBuffer.h"
+#include "../assignment_3/ring_buffer.h"
+#include "../assignment_3/types.h"
+#include "FastSim.h"
+#include "MemoryPort.h"
+
+/*
+ * The fast model with the processors on several host threads, bound-weave
+ * style. Time advances in quanta of a fixed number of cycles.
+ * In the bound phase every processor runs its trace against its own cache
+ * on a worker thread until the end of the quantum, as if bus and memory
+ * were idle, and records its bus transactions.
+ * In the weave phase one thread replays the recorded transactions of all
+ * processors through the arbiter and the memory in cycle order and applies
+ * their snoops to the other caches. The contention a transaction met
+ * delays the rest of its processor, the next bound phase starts later.
+ * The caches are the LRU sets of FastSim. The weave phase applies the
+ * snoops with the transitions of FastSim, also the ones of a line snooped
+ * while its own transaction waits: it leaves the set, is read again, or
+ * is put back without its count.
+ * A cache sees the snoops of the others only at the end of a quantum, and
+ * its hits in between are not checked against them, the accuracy report
+ * measures the error against FastSim.
+ */
+class ParallelSim {
+public:
+    ParallelSim(SimulationContext &context, const sim_config &config, const char *tracefile, uint32_t threads,
+                uint64_t quantum);
+
+    ~ParallelSim();
+
+    // Runs the trace to the end, returns the cycle the simulation stopped at.
+    uint64_t run();
+
+    // The statistics of FastSim::print_stats, with the quanta.
+    void print_stats(std::ostream &os, uint64_t cycles) const;
+
+    const std::vector<cpu_summary> &summary() const {
+        return this->summaries;
+    }
+
+    // The most processors --accuracy was checked on, within 1% of
+    // FastSim. Above it a busy bus drifts, 14% on 255 processors.
+    static const uint32_t VALIDATED_CPUS = 64;
+
+private:
+    static const uint64_t NEVER = UINT64_MAX;
+
+    enum event_kind {
+        invalidate = 0, // a write, granted when acked.
+        fill = 1,       // a miss, done when the line arrived.
+        write_back = 2, // an eviction, done when the memory answered.
+    };
+
+    enum event_state {
+        waiting = 0,   // not issued yet.
+        requested = 1, // waits for the bus.
+        acked = 2,     // waits for the memory.
+    };
+
+    typedef struct event {
+        event_kind kind;
+        uint64_t addr;
+        uint64_t issue; // the positive edge it was issued at in the bound phase.
+        bool miss;      // an invalidation of a write miss, after its fill.
+    } event;
+
+    typedef struct core {
+        // Written by the bound phase, the weave phase applies the snoops.
+        std::vector<LRU *> sets;
+        uint64_t clock; // the positive edge of the next trace entry, without contention.
+        bool ended;
+        // The transactions the weave phase did not finish, the first one in flight.
+        RingBuffer<event> events;
+        // The lines it took (line << 1 | 1) and evicted (line << 1) since
+        // the last weave phase, in order.
+        std::vector<uint64_t> changes;
+        // Written by the weave phase.
+        event_state state;
+        uint64_t issue_at;
+        int64_t delay; // the contention met so far, in cycles.
+        bool refill;   // the line of the fill in flight was snooped away.
+    } core;
+
+    // Every worker waits for the others at the end of a phase.
+    class barrier {
+    public:
+        explicit barrier(uint32_t count) : count(count) {}
+
+        void wait();
+
+    private:
+        std::mutex lock;
+        std::condition_variable all_arrived;
+        uint32_t count;
+        uint32_t arrived = 0;
+        uint64_t generation = 0;
+    };
+
+    SimulationContext &context;
+    uint32_t num_cpus;
+    uint32_t num_threads;
+    uint64_t quantum;
+    uint64_t quanta = 0;
+    TraceBuffer trace;
+    std::vector<core> cores;
+    std::vector<cpu_summary> summaries;
+
+    // The bus and memory of the weave phase.
+    Arbiter *arbiter;
+    MemoryPort memory;
+    // The processors with a transaction to issue, the earliest first, then by id.
+    std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>,
+            std::greater<std::pair<uint64_t, uint32_t>>> issues;
+    uint64_t woven = 0; // the first cycle the weave phase did not simulate.
+    // The caches a snoop visits, the changes of the bound phase are applied
+    // at the start of the weave phase.
+    SnoopFilter snoop_filter;
+    std::vector<uint32_t> snoop_targets;
+    std::vector<uint32_t> relinked; // caches that put a snooped line back.
+
+    std::vector<std::thread> workers;
+    barrier sync;
+    uint64_t bound_end = 0;
+    bool stopping = false;
+
+    void work(uint32_t worker);
+
+    // The bound phase of the processors of `worker`.
+    void bound(uint32_t worker);
+
+    void access(uint32_t id, bool write, uint64_t addr);
+
+    void record(uint32_t id, event_kind kind, uint64_t addr, uint64_t *cycle, bool miss = false);
+
+    // The cycles a transaction takes on an idle bus and memory.
+    static uint64_t zero_load(event_kind kind);
+
+    // Simulates bus and memory from `woven` up to `end`.
+    void weave(uint64_t end);
+
+    void bus_negedge(uint64_t cycle);
+
+    // Applies the snoops of a granted transaction to the other caches.
+    void snoop(uint32_t id, const event &ev);
+
+    // The invalidation of the line of `id` that holds `addr`, with what
+    // FastSim does once the transaction `id` waits for was granted.
+    void invalidate_line(uint32_t id, LRU *lru, LRUnit *line, uint64_t addr);
+
+    // The transaction of `id` finished, its processor resumes at `cycle`.
+    void complete(uint32_t id, uint64_t cycle);
+
+    // Queues the next transaction of `id`, at `cycle` at the earliest.
+    void schedule(uint32_t id, uint64_t cycle);
+
+    // The first cycle from `cycle` on at which bus or memory act.
+    uint64_t next_cycle(uint64_t cycle) const;
+
+    LRU *set_of(uint32_t id, uint64_t addr) const {
+        return this->cores[id].sets[(addr >> 5) % NR_SETS];
+    }
+};
+
+#endif //FRAMEWORK_PARALLEL_SIM_H
@@ -0,0 +1,260 @@
+/*
+// File: main.cpp
+//
+// The assignment_3 model on the fast engine, without sc_main.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../assignment_3/FunctionalWarmup.h"
+#include "FastSim.h"
+#include "ParallelSim.h"
+#include "simulation.h"
+
+using namespace std;
+
+static const char *fast_usage =
+        "usage: fast_sim.bin <tracefile> [fast_sim options] [assignment_3 options]\n"
+        "  --check <output>    compare the statistics with the output of assignment_3.bin\n"
+        "                      for the same trace and options, - reads it from stdin\n"
+        "  --threads <n>       run the processors on n host threads, bound-weave (default: 1),\n"
+        "                      checked up to 64 processors, warns above\n"
+        "  --quantum <cycles>  cycles between two weave phases (default: 1000)\n"
+        "  --accuracy          with --threads, compare with the serial engine\n";
+
+// Takes an option of fast_sim out of the options, parse_config rejects
+// it. Returns its value, or the option itself when it has none.
+static const char *take_option(int *argc, char *argv[], const char *name, bool has_value) {
+    int width = has_value ? 2 : 1;
+    // argv[*argc - 1] is the last option, see parse_config.
+    for (int i = 0; i < *argc - 1; i++) {
+        if (strcmp(argv[i], name) != 0) continue;
+        if (has_value && i + 1 >= *argc - 1) {
+            throw runtime_error(string("Error, ") + name + " expects a value\n" + fast_usage);
+        }
+        const char *value = argv[i + width - 1];
+        for (int j = i; j + width < *argc; j++) {
+            argv[j] = argv[j + width];
+        }
+        *argc -= width;
+        return value;
+    }
+    return nullptr;
+}
+
+static uint64_t parse_count(const char *name, const char *value) {
+    char *end;
+    unsigned long long count = strtoull(value, &end, 10);
+    if (*end != '\0' || count == 0) {
+        throw runtime_error(string("Error, ") + name + " expects a positive number\n" + fast_usage);
+    }
+    return count;
+}
+
+template<class Engine>
+static void print_stats(const SimulationContext &context, const Engine &sim, uint64_t cycles, ostream &out) {
+    context.stats_print(out);
+    sim.print_stats(out, cycles);
+    out << cycles << " ns" << endl;
+}
+
+static double percent_error(double value, double reference) {
+    return reference == 0 ? 0 : 100 * (value - reference) / reference;
+}
+
+static void print_accuracy(const vector<cpu_summary> &parallel, uint64_t parallel_cycles, double parallel_ms,
+                           const vector<cpu_summary> &serial, uint64_t serial_cycles, double serial_ms) {
+    printf("Accuracy against the serial engine\n");
+    printf("Manager\tHitrate\t\tSerial\t\tAvgWaitBus\tSerial\n");
+    for (size_t i = 0; i < parallel.size(); i++) {
+        const cpu_summary &p = parallel[i], &s = serial[i];
+        printf("%lu\t%f\t%f\t%f\t%f\n", (unsigned long) i,
+               p.accesses ? 100.0 * p.hits / p.accesses : 0, s.accesses ? 100.0 * s.hits / s.accesses : 0,
+               p.bus_waits ? (double) p.bus_wait_cycles / p.bus_waits : 0,
+               s.bus_waits ? (double) s.bus_wait_cycles / s.bus_waits : 0);
+    }
+    printf("Cycles: %lu, serial %lu, error %.3f%%\n", (unsigned long) parallel_cycles,
+           (unsigned long) serial_cycles, percent_error((double) parallel_cycles, (double) serial_cycles));
+    printf("Host time: %.1f ms, serial %.1f ms, speedup %.2fx\n", parallel_ms, serial_ms,
+           parallel_ms > 0 ? serial_ms / parallel_ms : 0);
+}
+
+static double elapsed_ms(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+
+static vector<string> split_lines(istream &in) {
+    vector<string> lines;
+    string line;
+    while (getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// The unit of a time as sc_time prints it, in ns, 0 if `unit` is none.
+static double unit_scale(const string &unit) {
+    static const struct { const char *unit; double scale; } units[] = {
+            {"fs", 1e-6}, {"ps", 1e-3}, {"ns", 1}, {"us", 1e3}, {"ms", 1e6}, {"s", 1e9},
+    };
+    for (const auto &u : units) {
+        if (unit == u.unit) {
+            return u.scale;
+        }
+    }
+    return 0;
+}
+
+static bool same_line(const string &systemc, const string &fast) {
+    if (systemc == fast) {
+        return true;
+    }
+    // sc_time prints large times with six digits, the fast time is compared
+    // as printed in the same unit and precision.
+    istringstream systemc_in(systemc), fast_in(fast);
+    string value, unit, rest;
+    uint64_t ns;
+    if (!(systemc_in >> value >> unit) || systemc_in >> rest || !(fast_in >> ns >> rest) || rest != "ns") {
+        return false;
+    }
+    double scale = unit_scale(unit);
+    if (scale == 0) {
+        return false;
+    }
+    ostringstream printed;
+    printed << (double) ns / scale;
+    return printed.str() == value;
+}
+
+// Compares the statistics, from the processor table on, with the output of
+// the SystemC model. Returns false and reports the first difference.
+static bool cross_check(const char *reference, const string &stats) {
+    ifstream file;
+    if (strcmp(reference, "-") != 0) {
+        file.open(reference);
+        if (!file.is_open()) {
+            throw runtime_error(string("Error, unable to open ") + reference + "\n");
+        }
+    }
+    vector<string> systemc = split_lines(strcmp(reference, "-") == 0 ? cin : file);
+    istringstream fast_in(stats);
+    vector<string> fast = split_lines(fast_in);
+
+    size_t start = 0;
+    while (start < systemc.size() && systemc[start].compare(0, 8, "Manager\t") != 0) {
+        start++;
+    }
+    if (start == systemc.size()) {
+        cerr << "Cross-check: no statistics in " << reference << endl;
+        return false;
+    }
+    systemc.erase(systemc.begin(), systemc.begin() + (long) start);
+
+    for (size_t i = 0; i < max(systemc.size(), fast.size()); i++) {
+        string a = i < systemc.size() ? systemc[i] : "<end>";
+        string b = i < fast.size() ? fast[i] : "<end>";
+        if (!same_line(a, b)) {
+            cerr << "Cross-check: statistics line " << i + 1 << " differs" << endl;
+            cerr << "  systemc: " << a << endl;
+            cerr << "  fast:    " << b << endl;
+            return false;
+        }
+    }
+    cerr << "Cross-check: identical to " << reference << endl;
+    return true;
+}
+
+// Like top.cpp, the statistics come first.
+static void write_checkpoint(const sim_config &config, const FastSim &sim) {
+    if (!sim.drained()) {
+        throw runtime_error("Error, the trace ended before cycle " + to_string(config.checkpoint_at)
+                            + ", no checkpoint was written\n");
+    }
+    checkpoint state;
+    sim.save(state);
+    save_checkpoint(config.checkpoint_file, state);
+    cerr << "Checkpoint of cycle " << state.cycle << " written to " << config.checkpoint_file << endl;
+}
+
+template<class Engine>
+static int report(const SimulationContext &context, const Engine &sim, uint64_t cycles, const char *reference) {
+    if (reference == nullptr) {
+        print_stats(context, sim, cycles, cout);
+        return 0;
+    }
+    ostringstream captured;
+    print_stats(context, sim, cycles, captured);
+    string stats = captured.str();
+    cout << stats;
+    cout.flush();
+    return cross_check(reference, stats) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *tracefile = argc > 1 ? argv[1] : nullptr;
+        SimulationContext context;
+        init_tracefile(context, &argc, &argv);
+        const char *reference = take_option(&argc, argv, "--check", true);
+        const char *threads = take_option(&argc, argv, "--threads", true);
+        const char *quantum = take_option(&argc, argv, "--quantum", true);
+        bool accuracy = take_option(&argc, argv, "--accuracy", false) != nullptr;
+        sim_config config = parse_config(argc, argv);
+        if (threads == nullptr && (quantum != nullptr || accuracy)) {
+            throw runtime_error(string("Error, --quantum and --accuracy need --threads\n") + fast_usage);
+        }
+
+        context.stats_init();
+        if (threads == nullptr) {
+            FastSim sim(context, config, tracefile);
+            if (config.restore_file != nullptr) {
+                sim.restore(load_checkpoint(config.restore_file));
+            } else if (config.warmup_entries > 0 || config.warmup_percent > 0) {
+                sim.restore(FunctionalWarmup::warm_up(config, tracefile, context.num_cpus, NR_SETS));
+            }
+            uint64_t cycles = sim.run();
+            int result = report(context, sim, cycles, reference);
+            if (config.checkpoint_file != nullptr) {
+                write_checkpoint(config, sim);
+            }
+            return result;
+        }
+
+        vector<cpu_summary> serial;
+        uint64_t serial_cycles = 0;
+        double serial_ms = 0;
+        if (accuracy) {
+            // Its own statistics, the parallel run reports in `context`.
+            SimulationContext serial_context(context.num_cpus);
+            serial_context.stats_init();
+            FastSim sim(serial_context, config, tracefile);
+            auto start = chrono::steady_clock::now();
+            serial_cycles = sim.run();
+            serial_ms = elapsed_ms(start);
+            serial = sim.summary();
+        }
+
+        ParallelSim sim(context, config, tracefile, (uint32_t) parse_count("--threads", threads),
+                        quantum ? parse_count("--quantum", quantum) : 1000);
+        auto start = chrono::steady_clock::now();
+        uint64_t cycles = sim.run();
+        double parallel_ms = elapsed_ms(start);
+        int result = report(context, sim, cycles, reference);
+        if (accuracy) {
+            print_accuracy(sim.summary(), cycles, parallel_ms, serial, serial_cycles, serial_ms);
+        }
+        return result;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+    }
+    return 1;
+}
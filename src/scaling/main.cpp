@@ -0,0 +1,232 @@
+/*
+// File: main.cpp
+//
+// Host time and memory of a simulator as the number of processors grows,
+// on generated traces of the same length per processor.
+*/
+
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../fast_sim/FastSim.h"
+#include "simulation.h"
+
+using namespace std;
+
+static const char *usage =
+        "usage: scaling.bin [options] [-- <simulator> [options]]\n"
+        "  --cpus <n,...>      the processor counts (default: 1,4,16,64,256,1024)\n"
+        "  --entries <n>       trace entries per processor (default: 1000)\n"
+        "  --shared <percent>  accesses to lines every processor shares (default: 10)\n"
+        "  --dir <dir>         where the traces go, one per count (default: .)\n"
+        "  --keep              keep the traces\n"
+        "Without a simulator the fast engine runs in a child process, otherwise the\n"
+        "simulator runs as `<simulator> <tracefile> [options]`, its stdout discarded.\n";
+
+// Lines every processor may touch, and the lines of a processor of its own.
+static const uint64_t SHARED_LINES = 64;
+static const uint64_t PRIVATE_LINES = 2048;
+
+static uint64_t parse_number(const char *option, const char *value) {
+    char *end;
+    unsigned long long number = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+        throw runtime_error(string("Error, ") + option + " expects a number, got: " + value + "\n" + usage);
+    }
+    return number;
+}
+
+static void put_be32(ofstream &out, uint32_t value) {
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (unsigned char) (value >> (24 - 8 * i));
+    }
+    out.write((const char *) bytes, 4);
+}
+
+static void put_be64(ofstream &out, uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char) (value >> (56 - 8 * i));
+    }
+    out.write((const char *) bytes, 8);
+}
+
+// A trace in the format of TraceFile, the same for the same arguments. Two
+// thirds of the accesses read, the others write, `shared` percent of them
+// to the shared lines.
+static void write_trace(const string &path, uint32_t num_cpus, uint64_t entries, uint32_t shared) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        throw runtime_error("Error, unable to write " + path + "\n");
+    }
+    mt19937_64 random(num_cpus * 1000003ULL + entries);
+    out.write("4TRF", 4);
+    put_be32(out, num_cpus);
+    for (uint64_t i = 0; i < entries; i++) {
+        for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+            uint64_t type = random() % 3 == 0 ? TraceFile::ENTRY_TYPE_WRITE : TraceFile::ENTRY_TYPE_READ;
+            uint64_t addr;
+            if (random() % 100 < shared) {
+                addr = 0x1000 + (random() % SHARED_LINES) * BLOCK_SIZE;
+            } else {
+                addr = ((uint64_t) cpu + 1) * 0x100000 + (random() % PRIVATE_LINES) * BLOCK_SIZE;
+            }
+            put_be64(out, (type << 62) | addr);
+        }
+    }
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        put_be64(out, (uint64_t) TraceFile::ENTRY_TYPE_END << 62);
+    }
+    out.close();
+    if (out.fail()) {
+        throw runtime_error("Error, unable to write " + path + "\n");
+    }
+}
+
+// The body of the child that runs the fast engine.
+static int run_fast(const char *tracefile, uint32_t num_cpus) {
+    try {
+        char *argv[] = {nullptr};
+        sim_config config = parse_config(1, argv);
+        FastSim::check_config(config);
+        SimulationContext context(num_cpus);
+        context.stats_init();
+        FastSim sim(context, config, tracefile);
+        sim.run();
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct measurement {
+    bool ok;
+    double host_ms;
+    long max_rss_kb; // of the child, as getrusage reports it.
+} measurement;
+
+static measurement measure(const string &tracefile, uint32_t num_cpus, const vector<char *> &simulator) {
+    cout.flush();
+    fflush(stdout);
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw runtime_error(string("Error, unable to start a run: ") + strerror(errno) + "\n");
+    }
+    if (pid == 0) {
+        // A simulator without -q logs on cout, only the host cost counts.
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+        if (simulator.empty()) {
+            _exit(run_fast(tracefile.c_str(), num_cpus));
+        }
+        vector<char *> argv(simulator);
+        argv.insert(argv.begin() + 1, const_cast<char *>(tracefile.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        cerr << "Error, unable to run " << argv[0] << ": " << strerror(errno) << endl;
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            throw runtime_error(string("Error, lost the run: ") + strerror(errno) + "\n");
+        }
+    }
+    double host_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return measurement{WIFEXITED(status) && WEXITSTATUS(status) == 0, host_ms, usage.ru_maxrss};
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        vector<uint32_t> counts{1, 4, 16, 64, 256, 1024};
+        uint64_t entries = 1000;
+        uint32_t shared = 10;
+        string dir = ".";
+        bool keep = false;
+        vector<char *> simulator;
+        for (int i = 1; i < argc; i++) {
+            bool has_value = i + 1 < argc;
+            if (!strcmp(argv[i], "--cpus") && has_value) {
+                counts.clear();
+                stringstream in(argv[++i]);
+                string count;
+                while (getline(in, count, ',')) {
+                    counts.push_back((uint32_t) parse_number("--cpus", count.c_str()));
+                }
+            } else if (!strcmp(argv[i], "--entries") && has_value) {
+                entries = parse_number(argv[i], argv[i + 1]);
+                i++;
+            } else if (!strcmp(argv[i], "--shared") && has_value) {
+                shared = (uint32_t) parse_number(argv[i], argv[i + 1]);
+                i++;
+            } else if (!strcmp(argv[i], "--dir") && has_value) {
+                dir = argv[++i];
+            } else if (!strcmp(argv[i], "--keep")) {
+                keep = true;
+            } else if (!strcmp(argv[i], "--") && has_value) {
+                simulator.assign(argv + i + 1, argv + argc);
+                break;
+            } else {
+                throw runtime_error(string("Error, unknown option: ") + argv[i] + "\n" + usage);
+            }
+        }
+        if (entries == 0 || shared > 100) {
+            throw runtime_error(string("Error, a trace needs entries and at most 100 percent shared\n") + usage);
+        }
+        for (uint32_t count : counts) {
+            if (count == 0 || count > MAX_CPUS) {
+                throw runtime_error("Error, --cpus expects 1 to " + to_string(MAX_CPUS) + " processors\n" + usage);
+            }
+        }
+
+        printf("CPUs\tAccesses\tHostMs\t\tNsPerAccess\tMaxRssKB\tKBPerCPU\n");
+        size_t failed = 0;
+        for (uint32_t count : counts) {
+            string tracefile = dir + "/scaling_" + to_string(count) + ".trf";
+            write_trace(tracefile, count, entries, shared);
+            measurement m = measure(tracefile, count, simulator);
+            if (!keep) {
+                remove(tracefile.c_str());
+            }
+            uint64_t accesses = entries * count;
+            if (!m.ok) {
+                printf("%u\t%lu\t\t-\t\t-\t\t-\t\t-\n", count, (unsigned long) accesses);
+                failed++;
+                continue;
+            }
+            printf("%u\t%lu\t\t%f\t%f\t%ld\t\t%f\n", count, (unsigned long) accesses, m.host_ms,
+                   1e6 * m.host_ms / (double) accesses, m.max_rss_kb, (double) m.max_rss_kb / count);
+            fflush(stdout);
+        }
+        if (failed > 0) {
+            cerr << "Scaling: " << failed << " runs failed" << endl;
+            return 1;
+        }
+        return 0;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+    }
+    return 1;
+}
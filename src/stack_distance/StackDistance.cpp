@@ -0,0 +1,148 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+#include "StackDistance.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+void OrderTree::split(uint32_t n, uint64_t key, uint32_t *below, uint32_t *rest) {
+    if (n == 0) {
+        *below = 0;
+        *rest = 0;
+        return;
+    }
+    if (this->nodes[n].key < key) {
+        this->split(this->nodes[n].right, key, &this->nodes[n].right, rest);
+        *below = n;
+    } else {
+        this->split(this->nodes[n].left, key, below, &this->nodes[n].left);
+        *rest = n;
+    }
+    this->update(n);
+}
+
+uint32_t OrderTree::merge(uint32_t a, uint32_t b) {
+    if (a == 0 || b == 0) {
+        return a + b;
+    }
+    if (this->nodes[a].priority > this->nodes[b].priority) {
+        this->nodes[a].right = this->merge(this->nodes[a].right, b);
+        this->update(a);
+        return a;
+    }
+    this->nodes[b].left = this->merge(a, this->nodes[b].left);
+    this->update(b);
+    return b;
+}
+
+void OrderTree::insert(uint64_t key) {
+    // xorshift32 priorities.
+    this->seed ^= this->seed << 13;
+    this->seed ^= this->seed >> 17;
+    this->seed ^= this->seed << 5;
+
+    uint32_t n;
+    if (this->free_nodes.empty()) {
+        n = (uint32_t) this->nodes.size();
+        this->nodes.push_back(node{key, this->seed, 1, 0, 0});
+    } else {
+        n = this->free_nodes.back();
+        this->free_nodes.pop_back();
+        this->nodes[n] = node{key, this->seed, 1, 0, 0};
+    }
+
+    uint32_t below, rest;
+    this->split(this->root, key, &below, &rest);
+    this->root = this->merge(this->merge(below, n), rest);
+}
+
+void OrderTree::erase(uint64_t key) {
+    uint32_t below, rest, match;
+    this->split(this->root, key, &below, &rest);
+    this->split(rest, key + 1, &match, &rest);
+    if (match != 0) {
+        this->free_nodes.push_back(match);
+    }
+    this->root = this->merge(below, rest);
+}
+
+size_t OrderTree::rank(uint64_t key) const {
+    size_t below = 0;
+    uint32_t n = this->root;
+    while (n != 0) {
+        if (this->nodes[n].key < key) {
+            below += this->nodes[this->nodes[n].left].size + 1;
+            n = this->nodes[n].right;
+        } else {
+            n = this->nodes[n].left;
+        }
+    }
+    return below;
+}
+
+StackDistance::StackDistance(size_t max_lines, size_t max_ways) {
+    if (max_lines == 0 || (max_lines & (max_lines - 1)) != 0 || max_ways == 0 || (max_ways & (max_ways - 1)) != 0) {
+        throw runtime_error("Error, the cache bounds must be powers of two\n");
+    }
+    for (size_t sets = 1; sets <= max_lines; sets *= 2) {
+        // Fully associative caches of up to max_lines lines.
+        size_t depth = sets == 1 ? max_lines : min(max_ways, max_lines / sets);
+        this->ways.push_back(depth);
+        this->stacks.emplace_back(sets == 1 ? 0 : sets * depth, 0);
+        this->hits.emplace_back(depth, 0);
+    }
+}
+
+void StackDistance::access(uint64_t addr) {
+    uint64_t line = addr / LINE_SIZE;
+    uint64_t now = ++this->time;
+
+    auto last = this->lines.find(line);
+    if (last == this->lines.end()) {
+        this->lines.emplace(line, now);
+    } else {
+        // The lines used after the previous access.
+        size_t distance = this->tree.size() - this->tree.rank(last->second) - 1;
+        if (distance < this->hits[0].size()) {
+            this->hits[0][distance]++;
+        }
+        this->tree.erase(last->second);
+        last->second = now;
+    }
+    this->tree.insert(now);
+
+    for (size_t level = 1; level < this->stacks.size(); level++) {
+        size_t depth = this->ways[level];
+        uint64_t *set = &this->stacks[level][(line & (((uint64_t) 1 << level) - 1)) * depth];
+        // Its depth in the set, or the last way when it is not there.
+        size_t d = 0;
+        while (d < depth - 1 && set[d] != line + 1) {
+            d++;
+        }
+        if (set[d] == line + 1) {
+            this->hits[level][d]++;
+        }
+        for (; d > 0; d--) {
+            set[d] = set[d - 1];
+        }
+        set[0] = line + 1;
+    }
+}
+
+uint64_t StackDistance::misses(size_t sets, size_t ways) const {
+    size_t level = 0;
+    while (((size_t) 1 << level) < sets) {
+        level++;
+    }
+    if (level >= this->hits.size() || ((size_t) 1 << level) != sets || ways > this->hits[level].size()) {
+        throw runtime_error("Error, the cache is out of the bounds of the stack distances\n");
+    }
+    uint64_t hit = 0;
+    for (size_t d = 0; d < ways; d++) {
+        hit += this->hits[level][d];
+    }
+    return this->time - hit;
+}
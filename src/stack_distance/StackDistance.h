@@ -0,0 +1,104 @@
+//
+// Created by yanghoo on 3/14/24.
+//
+
+#ifndef FRAMEWORK_STACK_DISTANCE_H
+#define FRAMEWORK_STACK_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cache_size.h"
+
+/*
+ * Keys in an order statistic tree, a treap with subtree sizes: insert,
+ * erase and the rank of a key in O(log n).
+ */
+class OrderTree {
+public:
+    void insert(uint64_t key);
+
+    // The key must be in the tree.
+    void erase(uint64_t key);
+
+    // The number of keys below `key`.
+    size_t rank(uint64_t key) const;
+
+    size_t size() const {
+        return this->nodes[this->root].size;
+    }
+
+private:
+    typedef struct node {
+        uint64_t key;
+        uint32_t priority;
+        uint32_t size;
+        uint32_t left;
+        uint32_t right;
+    } node;
+
+    // Node 0 is the empty tree.
+    std::vector<node> nodes = std::vector<node>(1, node{0, 0, 0, 0, 0});
+    std::vector<uint32_t> free_nodes;
+    uint32_t root = 0;
+    uint32_t seed = 2463534242u;
+
+    void update(uint32_t n) {
+        this->nodes[n].size = 1 + this->nodes[this->nodes[n].left].size + this->nodes[this->nodes[n].right].size;
+    }
+
+    // The keys of `n` below `key` go to `below`, the others to `rest`.
+    void split(uint32_t n, uint64_t key, uint32_t *below, uint32_t *rest);
+
+    // Every key of `a` is below the keys of `b`.
+    uint32_t merge(uint32_t a, uint32_t b);
+};
+
+/*
+ * Mattson's LRU stack distances of one processor, for every power of two
+ * number of sets at once. In a cache of S sets a line hits iff fewer than
+ * its ways other lines of its set were used since its last access, so one
+ * distance histogram per S gives the misses of every associativity, and
+ * S = 1 those of the fully associative caches.
+ * With one set the distance is unbounded: the tree holds the time of the
+ * last access of every line seen, the distance is the number of later
+ * ones. With more sets only distances below max_ways count, every set
+ * keeps its max_ways most recently used lines.
+ * Lines are allocated on reads and writes and never invalidated, like the
+ * LRU of assignment_1.
+ */
+class StackDistance {
+public:
+    // Caches of up to `max_lines` lines and distances up to `max_ways` in a
+    // set-associative cache, both powers of two.
+    StackDistance(size_t max_lines, size_t max_ways);
+
+    void access(uint64_t addr);
+
+    uint64_t accesses() const {
+        return this->time;
+    }
+
+    // First uses of a line, they miss in every cache.
+    uint64_t cold_misses() const {
+        return this->lines.size();
+    }
+
+    // The misses of a cache of `sets` sets of `ways` ways, ways up to
+    // max_ways with more than one set.
+    uint64_t misses(size_t sets, size_t ways) const;
+
+private:
+    OrderTree tree;
+    // stacks[i] of 1 << i sets, ways[i] lines per set, most recently used
+    // first. A line is stored + 1, 0 is a free way.
+    std::vector<std::vector<uint64_t>> stacks;
+    std::vector<size_t> ways;
+    std::vector<std::vector<uint64_t>> hits; // hits[i][d], accesses at distance d.
+    std::unordered_map<uint64_t, uint64_t> lines; // line to the time of its last access.
+    uint64_t time = 0;
+};
+
+#endif //FRAMEWORK_STACK_DISTANCE_H
@@ -0,0 +1,121 @@
+/*
+// File: main.cpp
+//
+// LRU miss rates of every cache size and associativity up to a bound, for
+// every processor, from one pass over the trace.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "StackDistance.h"
+#include "simulation.h"
+
+using namespace std;
+
+static const char *usage =
+        "usage: stack_distance.bin <tracefile> [options]\n"
+        "  --max-size <n>[K|M] largest cache in bytes, a power of two (default: 1M)\n"
+        "  --max-ways <n>      highest associativity, a power of two (default: 16)\n";
+
+// The smallest cache of the table.
+static const size_t MIN_SIZE = 1 << 10;
+
+static size_t parse_size(const char *option, const char *value) {
+    char *end = nullptr;
+    unsigned long long size = strtoull(value, &end, 10);
+    if (end != value && (*end == 'K' || *end == 'M')) {
+        size <<= *end == 'K' ? 10 : 20;
+        end++;
+    }
+    if (end == value || *end != '\0' || size == 0) {
+        throw runtime_error(string("Error, ") + option + " expects a positive number, got: " + value + "\n" + usage);
+    }
+    return (size_t) size;
+}
+
+// Miss rates in percent, a row per cache size and a column per
+// associativity, then the fully associative cache.
+static void print_curve(uint32_t cpuid, const StackDistance &profile, size_t max_size, size_t max_ways) {
+    printf("Manager %u: %lu accesses, %lu cold misses\n", cpuid, (unsigned long) profile.accesses(),
+           (unsigned long) profile.cold_misses());
+    printf("Size");
+    for (size_t ways = 1; ways <= max_ways; ways *= 2) {
+        printf("\t%lu-way\t", (unsigned long) ways);
+    }
+    printf("\tFull\n");
+
+    double accesses = (double) profile.accesses();
+    for (size_t size = min(MIN_SIZE, max_size); size <= max_size; size *= 2) {
+        size_t lines = size / LINE_SIZE;
+        printf("%s", size_name(size).c_str());
+        for (size_t ways = 1; ways <= max_ways; ways *= 2) {
+            if (ways > lines) {
+                printf("\t-\t");
+                continue;
+            }
+            uint64_t misses = profile.misses(lines / ways, ways);
+            printf("\t%f", accesses > 0 ? 100 * (double) misses / accesses : 0);
+        }
+        uint64_t misses = profile.misses(1, lines);
+        printf("\t%f\n", accesses > 0 ? 100 * (double) misses / accesses : 0);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        SimulationContext context;
+        init_tracefile(context, &argc, &argv);
+
+        size_t max_size = 1 << 20;
+        size_t max_ways = 16;
+        // argv[argc - 1] is the last option, see parse_config of assignment_3.
+        for (int i = 0; i < argc - 1; i++) {
+            bool has_value = i + 1 < argc - 1;
+            if (!strcmp(argv[i], "--max-size") && has_value) {
+                max_size = parse_size(argv[i], argv[i + 1]);
+                i++;
+            } else if (!strcmp(argv[i], "--max-ways") && has_value) {
+                max_ways = parse_size(argv[i], argv[i + 1]);
+                i++;
+            } else {
+                throw runtime_error(string("Error, unknown option: ") + argv[i] + "\n" + usage);
+            }
+        }
+        if (max_size < LINE_SIZE || max_size % LINE_SIZE != 0) {
+            throw runtime_error(string("Error, --max-size holds no whole line\n") + usage);
+        }
+
+        vector<StackDistance> profiles;
+        for (uint32_t i = 0; i < context.num_cpus; i++) {
+            profiles.emplace_back(max_size / LINE_SIZE, max_ways);
+        }
+
+        // One pass, the processors take turns like the simulators.
+        TraceFile::Entry entry;
+        while (!context.tracefile->eof()) {
+            for (uint32_t i = 0; i < context.num_cpus; i++) {
+                if (!context.tracefile->next(i, entry)) {
+                    throw runtime_error("Error reading trace for Manager " + to_string(i) + "\n");
+                }
+                if (entry.type == TraceFile::ENTRY_TYPE_READ || entry.type == TraceFile::ENTRY_TYPE_WRITE) {
+                    profiles[i].access(entry.addr);
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < context.num_cpus; i++) {
+            print_curve(i, profiles[i], max_size, min(max_ways, max_size / LINE_SIZE));
+        }
+        return 0;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+    }
+    return 1;
+}
@@ -0,0 +1,495 @@
+/*
+// File: main.cpp
+//
+// A grid of assignment_3 configurations on the fast engine, run by worker
+// processes or threads that share one mapping of the trace.
+*/
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "../assignment_3/FunctionalWarmup.h"
+#include "../fast_sim/FastSim.h"
+#include "simulation.h"
+
+using namespace std;
+
+static const char *sweep_usage =
+        "usage: sweep.bin <tracefile> --out <dir> [sweep options] [assignment_3 options]\n"
+        "  --out <dir>             one result file per point, kept to resume the sweep\n"
+        "  --vary <option> <v,...> the values of an assignment_3 option, on,off for a flag,\n"
+        "                          repeated for every dimension of the grid\n"
+        "  --jobs <n>              workers, one per host core (default: all cores)\n"
+        "  --threads               the workers are threads of this process, each point\n"
+        "                          with its own simulation context, instead of processes\n"
+        "  --simulator <path>      the points the fast engine cannot model run as\n"
+        "                          `<path> <tracefile> -q <options>`, like assignment_3.bin\n"
+        "The other options hold for every point. A result starts with the simulator,\n"
+        "the trace and the options of its point, a result of other ones is run again.\n";
+
+typedef struct dimension {
+    string option;
+    vector<string> values;
+    bool flag; // on and off, the option has no value.
+} dimension;
+
+typedef struct point {
+    vector<string> values; // one per dimension.
+    vector<string> args;   // the assignment_3 options.
+    sim_config config;
+    string name;           // the result file.
+    bool external;         // runs in the --simulator, the fast engine cannot model it.
+    string header;         // the first line of its result.
+} point;
+
+// A worker that runs a point.
+typedef struct worker {
+    pid_t pid;
+    size_t point;
+} worker;
+
+static vector<string> split(const string &text, char separator) {
+    vector<string> parts;
+    stringstream in(text);
+    string part;
+    while (getline(in, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+static sim_config parse_point(const vector<string> &args) {
+    // parse_config expects argv as init_tracefile leaves it.
+    vector<char *> argv;
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    return parse_config((int) argv.size(), argv.data());
+}
+
+// The grid, the last dimension changes fastest. `trace` names the trace
+// and its version in the header of a result.
+static vector<point> make_grid(const vector<dimension> &dimensions, const vector<string> &fixed,
+                               const string &simulator, const string &trace) {
+    vector<point> grid(1, point{vector<string>(), fixed, sim_config(), "", false, ""});
+    for (const auto &d : dimensions) {
+        vector<point> next;
+        for (const auto &p : grid) {
+            for (const auto &value : d.values) {
+                point q = p;
+                q.values.push_back(value);
+                if (!d.flag) {
+                    q.args.push_back(d.option);
+                    q.args.push_back(value);
+                } else if (value == "on") {
+                    q.args.push_back(d.option);
+                }
+                next.push_back(q);
+            }
+        }
+        grid = next;
+    }
+
+    for (auto &p : grid) {
+        for (size_t i = 0; i < dimensions.size(); i++) {
+            p.name += (i ? "," : "") + dimensions[i].option.substr(2) + "=" + p.values[i];
+        }
+        for (auto &c : p.name) {
+            if (!isalnum((unsigned char) c) && c != '=' && c != ',' && c != '.' && c != '-') {
+                c = '_';
+            }
+        }
+        if (p.name.empty()) {
+            p.name = "default";
+        }
+        // Every point is checked before the first one runs.
+        p.config = parse_point(p.args);
+        try {
+            FastSim::check_config(p.config);
+        } catch (runtime_error &e) {
+            if (simulator.empty()) {
+                throw runtime_error(p.name + ": " + e.what() + "--simulator runs such points, see the usage\n");
+            }
+            p.external = true;
+        }
+        if (p.config.checkpoint_file != nullptr) {
+            throw runtime_error(string("Error, the points of a sweep would overwrite each other's checkpoint\n")
+                                + sweep_usage);
+        }
+        p.header = "Point: " + (p.external ? simulator : string("fast_sim")) + " " + trace;
+        for (const auto &arg : p.args) {
+            p.header += " " + arg;
+        }
+    }
+    return grid;
+}
+
+// The first line of a result, empty if there is none.
+static string header_of(const string &path) {
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    return line;
+}
+
+// The body of a worker, its statistics go to `result`. A point is a
+// simulation of its own, in a context of its own.
+static int run_point(const point &p, uint32_t num_cpus, const char *tracefile, const unsigned char *file,
+                     size_t size, const string &result) {
+    string partial = result + ".partial";
+    ofstream out(partial, ios::trunc);
+    if (!out.is_open()) {
+        cerr << "Error, unable to write " + partial + "\n";
+        return 1;
+    }
+    out << p.header << endl;
+    try {
+        SimulationContext context(num_cpus);
+        context.stats_init();
+        FastSim sim(context, p.config, file, size);
+        if (p.config.restore_file != nullptr) {
+            sim.restore(load_checkpoint(p.config.restore_file));
+        } else if (p.config.warmup_entries > 0 || p.config.warmup_percent > 0) {
+            sim.restore(FunctionalWarmup::warm_up(p.config, tracefile, num_cpus, NR_SETS));
+        }
+        uint64_t cycles = sim.run();
+        context.stats_print(out);
+        sim.print_stats(out, cycles);
+        out << cycles << " ns" << endl;
+    } catch (exception &e) {
+        cerr << p.name + ": " + e.what() + "\n";
+        return 1;
+    }
+    out.close();
+    // A result only exists once it is complete.
+    return !out.fail() && rename(partial.c_str(), result.c_str()) == 0 ? 0 : 1;
+}
+
+// A point of the --simulator in a child process, its stdout is the result.
+static int run_external(const point &p, const string &simulator, const char *tracefile, const string &result) {
+    string partial = result + ".partial";
+    int fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    string header = p.header + "\n";
+    if (fd < 0 || write(fd, header.data(), header.size()) != (ssize_t) header.size()) {
+        cerr << "Error, unable to write " + partial + "\n";
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+    // Built before the fork, a thread of this process may hold the allocator.
+    vector<char *> argv{const_cast<char *>(simulator.c_str()), const_cast<char *>(tracefile),
+                        const_cast<char *>("-q")};
+    for (const auto &arg : p.args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fd);
+        cerr << string("Error, unable to start ") + simulator + ": " + strerror(errno) + "\n";
+        return 1;
+    }
+    if (pid == 0) {
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    close(fd);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return 1;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cerr << p.name + ": " + simulator + " failed\n";
+        return 1;
+    }
+    return rename(partial.c_str(), result.c_str()) == 0 ? 0 : 1;
+}
+
+// The point in the fast engine, or in the --simulator if it cannot.
+static int run_any(const point &p, const string &simulator, uint32_t num_cpus, const char *tracefile,
+                   const unsigned char *file, size_t size, const string &result) {
+    if (p.external) {
+        return run_external(p, simulator, tracefile, result);
+    }
+    return run_point(p, num_cpus, tracefile, file, size, result);
+}
+
+// Binds the calling process or thread to one host core, where the host
+// allows it.
+static void pin(size_t slot) {
+#ifdef __linux__
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cores > 0 ? slot % (size_t) cores : 0, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void) slot;
+#endif
+}
+
+static string progress(size_t finished, size_t pending, const point &p, bool ok) {
+    return "Sweep: [" + to_string(finished) + "/" + to_string(pending) + "] " + p.name + (ok ? "" : " failed")
+           + "\n";
+}
+
+// The points as threads of this process, the thread in slot k on host core k
+// takes the next point until none is left.
+static size_t run_threads(const vector<point> &grid, const vector<size_t> &pending, const string &dir,
+                          size_t jobs, const string &simulator, uint32_t num_cpus, const char *tracefile,
+                          const unsigned char *file, size_t size) {
+    atomic<size_t> next(0), failed(0);
+    size_t finished = 0;
+    mutex report;
+    vector<thread> workers;
+    for (size_t slot = 0; slot < min(jobs, pending.size()); slot++) {
+        workers.emplace_back([&, slot] {
+            pin(slot);
+            for (size_t i = next++; i < pending.size(); i = next++) {
+                const point &p = grid[pending[i]];
+                bool ok = run_any(p, simulator, num_cpus, tracefile, file, size, dir + "/" + p.name) == 0;
+                failed += ok ? 0 : 1;
+                lock_guard<mutex> guard(report);
+                cerr << progress(++finished, pending.size(), p, ok);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    return failed;
+}
+
+// Runs the points without a result of their own header, at most `jobs` at
+// once, the worker in slot k on host core k. Returns the points that failed.
+static size_t run_grid(const vector<point> &grid, const string &dir, size_t jobs, bool threads,
+                       const string &simulator, uint32_t num_cpus, const char *tracefile, const unsigned char *file,
+                       size_t size) {
+    vector<size_t> pending;
+    for (size_t i = 0; i < grid.size(); i++) {
+        string header = header_of(dir + "/" + grid[i].name);
+        if (header == grid[i].header) {
+            cerr << "Sweep: " << grid[i].name << " done before, reused" << endl;
+            continue;
+        }
+        if (!header.empty()) {
+            cerr << "Sweep: " << grid[i].name << " was run with other options or another trace, run again" << endl;
+        }
+        pending.push_back(i);
+    }
+    if (threads) {
+        return run_threads(grid, pending, dir, jobs, simulator, num_cpus, tracefile, file, size);
+    }
+
+    vector<worker> workers(jobs, worker{0, 0});
+    size_t next = 0, running = 0, failed = 0, finished = 0;
+    while (next < pending.size() || running > 0) {
+        for (size_t slot = 0; slot < jobs && next < pending.size(); slot++) {
+            if (workers[slot].pid != 0) continue;
+            const point &p = grid[pending[next]];
+            cout.flush();
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw runtime_error(string("Error, unable to start a worker: ") + strerror(errno) + "\n");
+            }
+            if (pid == 0) {
+                pin(slot);
+                _exit(run_any(p, simulator, num_cpus, tracefile, file, size, dir + "/" + p.name));
+            }
+            workers[slot] = worker{pid, pending[next]};
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            throw runtime_error(string("Error, lost the workers: ") + strerror(errno) + "\n");
+        }
+        for (auto &w : workers) {
+            if (w.pid != pid) continue;
+            bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            failed += ok ? 0 : 1;
+            cerr << progress(++finished, pending.size(), grid[w.point], ok);
+            w.pid = 0;
+            running--;
+        }
+    }
+    return failed;
+}
+
+typedef struct result {
+    bool found;
+    double hitrate;  // of all accesses, in percent.
+    double wait_bus; // the mean of the processors.
+    uint64_t cycles;
+} result;
+
+// The processor table of stats_print and the cycles on the last "<n> ns" line.
+static result read_result(const string &path) {
+    result r{false, 0, 0, 0};
+    ifstream in(path);
+    if (!in.is_open()) {
+        return r;
+    }
+    string line;
+    uint64_t cycles = 0;
+    bool table = false;
+    double hits = 0, accesses = 0, waits = 0;
+    size_t processors = 0;
+    while (getline(in, line)) {
+        if (line.compare(0, 8, "Manager\t") == 0) {
+            table = true;
+            continue;
+        }
+        vector<string> fields = split(line, '\t');
+        if (table && fields.size() >= 11 && isdigit((unsigned char) fields[0][0])) {
+            // Manager Reads RHit RMiss Writes WHit WMiss Hitrate MAccessTime (empty) WaitBus
+            hits += atof(fields[2].c_str()) + atof(fields[5].c_str());
+            accesses += atof(fields[1].c_str()) + atof(fields[4].c_str());
+            double wait = atof(fields[10].c_str());
+            waits += isnan(wait) ? 0 : wait;
+            processors++;
+        } else {
+            table = false;
+        }
+        size_t digits = line.find_first_not_of("0123456789");
+        if (digits > 0 && digits != string::npos && line.compare(digits, string::npos, " ns") == 0) {
+            cycles = strtoull(line.c_str(), nullptr, 10);
+        }
+    }
+    r.found = processors > 0;
+    r.hitrate = accesses > 0 ? 100 * hits / accesses : 0;
+    r.wait_bus = processors > 0 ? waits / (double) processors : 0;
+    r.cycles = cycles;
+    return r;
+}
+
+static void print_table(const vector<point> &grid, const vector<dimension> &dimensions, const string &dir) {
+    for (const auto &d : dimensions) {
+        printf("%s\t", d.option.c_str() + 2);
+    }
+    printf("Cycles\t\tHitrate\t\tWaitBus\n");
+    for (const auto &p : grid) {
+        for (const auto &value : p.values) {
+            printf("%s\t", value.c_str());
+        }
+        result r = read_result(dir + "/" + p.name);
+        if (!r.found) {
+            printf("-\t\t-\t\t-\n");
+            continue;
+        }
+        printf("%lu\t%f\t%f\n", (unsigned long) r.cycles, r.hitrate, r.wait_bus);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *tracefile = argc > 1 ? argv[1] : nullptr;
+        // Only for the number of processors, every point has a context.
+        SimulationContext context;
+        init_tracefile(context, &argc, &argv);
+
+        string dir;
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t jobs = cores > 0 ? (size_t) cores : 1;
+        bool threads = false;
+        string simulator;
+        vector<dimension> dimensions;
+        vector<string> fixed;
+        // argv[argc - 1] is the last option, see parse_config.
+        for (int i = 0; i < argc - 1; i++) {
+            int values = argc - 2 - i;
+            if (!strcmp(argv[i], "--out") && values >= 1) {
+                dir = argv[++i];
+            } else if (!strcmp(argv[i], "--jobs") && values >= 1) {
+                jobs = strtoul(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--threads")) {
+                threads = true;
+            } else if (!strcmp(argv[i], "--simulator") && values >= 1) {
+                simulator = argv[++i];
+            } else if (!strcmp(argv[i], "--vary") && values >= 2) {
+                dimension d{argv[i + 1], split(argv[i + 2], ','), true};
+                for (const auto &value : d.values) {
+                    d.flag = d.flag && (value == "on" || value == "off");
+                }
+                if (d.option.compare(0, 2, "--") != 0 || d.values.empty()) {
+                    throw runtime_error(string("Error, --vary expects an option and its values\n") + sweep_usage);
+                }
+                dimensions.push_back(d);
+                i += 2;
+            } else {
+                fixed.push_back(argv[i]);
+            }
+        }
+        if (dir.empty() || jobs == 0) {
+            throw runtime_error(string("Error, a sweep needs --out and at least one job\n") + sweep_usage);
+        }
+        // A trace written again has another size or time.
+        struct stat info;
+        if (stat(tracefile, &info) != 0) {
+            throw runtime_error(string("Unable to open file: ") + tracefile);
+        }
+        string trace = string(tracefile) + " " + to_string((long long) info.st_size) + " "
+                       + to_string((long long) info.st_mtime);
+        vector<point> grid = make_grid(dimensions, fixed, simulator, trace);
+
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw runtime_error("Error, unable to create " + dir + "\n");
+        }
+
+        // One read-only mapping, the workers inherit it.
+        int fd = open(tracefile, O_RDONLY);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            throw runtime_error(string("Unable to open file: ") + tracefile);
+        }
+        size_t size = (size_t) info.st_size;
+        void *file = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (file == MAP_FAILED) {
+            throw runtime_error(string("Unable to map file: ") + tracefile);
+        }
+
+        size_t failed = run_grid(grid, dir, jobs, threads, simulator, context.num_cpus, tracefile,
+                                 (const unsigned char *) file, size);
+        munmap(file, size);
+        print_table(grid, dimensions, dir);
+        if (failed > 0) {
+            cerr << "Sweep: " << failed << " points failed, run the sweep again to retry them" << endl;
+            return 1;
+        }
+        return 0;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+    }
+    return 1;
+}